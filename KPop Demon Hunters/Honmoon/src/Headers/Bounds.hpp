@@ -0,0 +1,80 @@
+#pragma once
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <limits>
+
+// Axis aligned bounding box
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+    void expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void expand(const Bounds& other) {
+        if (other.isEmpty()) return;
+        expand(other.min);
+        expand(other.max);
+    }
+};
+
+// Bounds of the 8 transformed corners
+inline Bounds TransformBounds(const Bounds& bounds, const glm::mat4& matrix) {
+    Bounds result;
+    if (bounds.isEmpty()) return result;
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner(
+            (i & 1) ? bounds.max.x : bounds.min.x,
+            (i & 2) ? bounds.max.y : bounds.min.y,
+            (i & 4) ? bounds.max.z : bounds.min.z
+        );
+        result.expand(glm::vec3(matrix * glm::vec4(corner, 1.0f)));
+    }
+
+    return result;
+}
+
+// Overlap seen from above, ignores height
+inline bool OverlapsXZ(const Bounds& bounds, float minX, float minZ, float maxX, float maxZ) {
+    return bounds.max.x >= minX && bounds.min.x <= maxX && bounds.max.z >= minZ && bounds.min.z <= maxZ;
+}
+
+// Planes of a view-projection matrix, normals point inside
+struct Frustum {
+    glm::vec4 planes[6];
+
+    explicit Frustum(const glm::mat4& viewProjection) {
+        glm::mat4 m = glm::transpose(viewProjection);
+        planes[0] = m[3] + m[0];   // left
+        planes[1] = m[3] - m[0];   // right
+        planes[2] = m[3] + m[1];   // bottom
+        planes[3] = m[3] - m[1];   // top
+        planes[4] = m[3] + m[2];   // near
+        planes[5] = m[3] - m[2];   // far
+    }
+
+    // Conservative, may keep boxes just outside a corner
+    bool intersects(const Bounds& bounds) const {
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 positive(
+                plane.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                plane.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                plane.z >= 0.0f ? bounds.max.z : bounds.min.z
+            );
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) return false;
+        }
+        return true;
+    }
+};
+
+// Squared distance from a point to the box, 0 inside
+inline float DistanceSquared(const Bounds& bounds, const glm::vec3& point) {
+    glm::vec3 d = glm::max(glm::max(bounds.min - point, point - bounds.max), glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
@@ -0,0 +1,265 @@
+#include "CpuHeightMap.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <immintrin.h>
+
+CpuHeightMap::CpuHeightMap(int width, int height)
+    : width(0), height(0), tilesX(0), tilesY(0)
+{
+    resize(width, height);
+}
+
+void CpuHeightMap::resize(int width, int height)
+{
+    if (width == this->width && height == this->height) return;
+
+    this->width = width;
+    this->height = height;
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    depth.assign(size_t(width) * height, 1.0f);
+}
+
+float CpuHeightMap::getHeight(int x, int y, const HonmoonParams& honmoon) const
+{
+    float cameraHeight = honmoon.center.y + HeightMap::yCamOffset;
+    return cameraHeight - (depth[size_t(y) * width + x] * (HeightMap::farPlane - HeightMap::nearPlane) + HeightMap::nearPlane);
+}
+
+void CpuHeightMap::bake(const std::vector<Model>& models, const DrawList& drawList, const HonmoonParams& honmoon, WorkerPool& workers)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    auto start = clock::now();
+    transform(models, drawList, honmoon, workers);
+
+    auto binStart = clock::now();
+    bin(workers);
+
+    auto rasterStart = clock::now();
+    rasterize(workers);
+
+    auto end = clock::now();
+
+    timing.width = width;
+    timing.height = height;
+    timing.triangles = triangles.size();
+    timing.tiles = getTileCount();
+    timing.threads = workers.size();
+    timing.transformMs = std::chrono::duration<float, std::milli>(binStart - start).count();
+    timing.binMs = std::chrono::duration<float, std::milli>(rasterStart - binStart).count();
+    timing.rasterMs = std::chrono::duration<float, std::milli>(end - rasterStart).count();
+
+    float totalMs = std::chrono::duration<float, std::milli>(end - start).count();
+    timing.trianglesPerSecond = totalMs > 0.0f ? timing.triangles / (totalMs / 1000.0f) : 0.0f;
+    timing.tilesPerSecond = timing.rasterMs > 0.0f ? timing.tiles / (timing.rasterMs / 1000.0f) : 0.0f;
+}
+
+void CpuHeightMap::transform(const std::vector<Model>& models, const DrawList& drawList, const HonmoonParams& honmoon, WorkerPool& workers)
+{
+    itemOffsets.resize(drawList.size() + 1);
+    itemOffsets[0] = 0;
+    for (size_t i = 0; i < drawList.size(); i++) {
+        const Mesh& mesh = models[drawList[i].modelIndex].getMeshes()[drawList[i].meshIndex];
+        itemOffsets[i + 1] = itemOffsets[i] + mesh.indices.size() / 3;
+    }
+
+    triangles.resize(itemOffsets.back());
+    visible.assign(triangles.size(), 0);
+
+    // Same mapping as HeightMap::update
+    float left = honmoon.center.x - honmoon.size.x / 2.0f;
+    float back = honmoon.center.z + honmoon.size.z / 2.0f;
+    glm::vec2 texelsPerUnit(width / honmoon.size.x, height / honmoon.size.z);
+    float cameraHeight = honmoon.center.y + HeightMap::yCamOffset;
+    float depthScale = 1.0f / (HeightMap::farPlane - HeightMap::nearPlane);
+
+    workers.parallelFor(drawList.size(), [&](size_t begin, size_t end, unsigned int) {
+        std::vector<glm::vec3> projected;
+
+        for (size_t i = begin; i < end; i++) {
+            const DrawItem& item = drawList[i];
+            const Mesh& mesh = models[item.modelIndex].getMeshes()[item.meshIndex];
+
+            projected.resize(mesh.vertices.size());
+            for (size_t v = 0; v < mesh.vertices.size(); v++) {
+                glm::vec3 world = glm::vec3(item.modelMatrix * glm::vec4(mesh.vertices[v].Position, 1.0f));
+                projected[v] = glm::vec3(
+                    (world.x - left) * texelsPerUnit.x,
+                    (back - world.z) * texelsPerUnit.y,
+                    (cameraHeight - world.y - HeightMap::nearPlane) * depthScale
+                );
+            }
+
+            size_t offset = itemOffsets[i];
+            for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+                const glm::vec3& a = projected[mesh.indices[t]];
+                const glm::vec3& b = projected[mesh.indices[t + 1]];
+                const glm::vec3& c = projected[mesh.indices[t + 2]];
+
+                Triangle& triangle = triangles[offset + t / 3];
+                triangle.a = glm::vec2(a);
+                triangle.b = glm::vec2(b);
+                triangle.c = glm::vec2(c);
+                triangle.depth = glm::vec3(a.z, b.z, c.z);
+
+                // Texel space keeps the screen orientation, counter clockwise is front facing
+                float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+                bool nearFar = std::min({ a.z, b.z, c.z }) <= 1.0f && std::max({ a.z, b.z, c.z }) >= 0.0f;
+                visible[offset + t / 3] = area > 0.0f && nearFar;
+            }
+        }
+    });
+}
+
+void CpuHeightMap::bin(WorkerPool& workers)
+{
+    bins.resize(workers.size());
+    for (auto& chunkBins : bins) {
+        chunkBins.resize(getTileCount());
+        for (auto& tileBin : chunkBins) tileBin.clear();
+    }
+
+    workers.parallelFor(triangles.size(), [&](size_t begin, size_t end, unsigned int chunk) {
+        auto& chunkBins = bins[chunk];
+
+        for (size_t i = begin; i < end; i++) {
+            if (!visible[i]) continue;
+
+            const Triangle& triangle = triangles[i];
+            glm::vec2 lo = glm::min(glm::min(triangle.a, triangle.b), triangle.c);
+            glm::vec2 hi = glm::max(glm::max(triangle.a, triangle.b), triangle.c);
+
+            // Pixel centers at +0.5
+            int x0 = std::max(int(std::ceil(lo.x - 0.5f)), 0);
+            int y0 = std::max(int(std::ceil(lo.y - 0.5f)), 0);
+            int x1 = std::min(int(std::floor(hi.x - 0.5f)), width - 1);
+            int y1 = std::min(int(std::floor(hi.y - 0.5f)), height - 1);
+            if (x0 > x1 || y0 > y1) continue;
+
+            for (int ty = y0 / tileSize; ty <= y1 / tileSize; ty++)
+                for (int tx = x0 / tileSize; tx <= x1 / tileSize; tx++)
+                    chunkBins[ty * tilesX + tx].push_back(static_cast<unsigned int>(i));
+        }
+    });
+}
+
+void CpuHeightMap::rasterize(WorkerPool& workers)
+{
+    // Tiles are handed out one at a time, geometry is rarely spread evenly
+    std::atomic<int> nextTile(0);
+
+    workers.parallelFor(workers.size(), [&](size_t, size_t, unsigned int) {
+        alignas(16) float tileDepth[tileSize * tileSize];
+
+        for (int tile = nextTile++; tile < getTileCount(); tile = nextTile++) {
+            rasterizeTile(tile, tileDepth);
+
+            int x0 = (tile % tilesX) * tileSize;
+            int y0 = (tile / tilesX) * tileSize;
+            int columns = std::min(tileSize, width - x0);
+            int rows = std::min(tileSize, height - y0);
+
+            for (int y = 0; y < rows; y++)
+                std::copy(tileDepth + y * tileSize, tileDepth + y * tileSize + columns, depth.begin() + size_t(y0 + y) * width + x0);
+        }
+    });
+}
+
+void CpuHeightMap::rasterizeTile(int tile, float* tileDepth) const
+{
+    std::fill(tileDepth, tileDepth + tileSize * tileSize, 1.0f);
+
+    int tileX = (tile % tilesX) * tileSize;
+    int tileY = (tile / tilesX) * tileSize;
+
+    const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (const auto& chunkBins : bins) {
+        for (unsigned int index : chunkBins[tile]) {
+            const Triangle& triangle = triangles[index];
+            const glm::vec2 v[3] = { triangle.a, triangle.b, triangle.c };
+
+            // Edge i is opposite to vertex i, E(p) = A * p.x + B * p.y + C is its barycentric weight
+            float A[3], B[3], C[3];
+            bool topLeft[3];
+            for (int e = 0; e < 3; e++) {
+                const glm::vec2& from = v[(e + 1) % 3];
+                const glm::vec2& to = v[(e + 2) % 3];
+                A[e] = from.y - to.y;
+                B[e] = to.x - from.x;
+                C[e] = from.x * to.y - from.y * to.x;
+
+                // Counter clockwise with y up: left edges go down, top edges go left
+                float dx = to.x - from.x, dy = to.y - from.y;
+                topLeft[e] = dy < 0.0f || (dy == 0.0f && dx < 0.0f);
+            }
+
+            float area = C[0] + C[1] + C[2];
+            float invArea = 1.0f / area;
+            glm::vec3 depthPlane = triangle.depth * invArea;
+
+            glm::vec2 lo = glm::min(glm::min(v[0], v[1]), v[2]);
+            glm::vec2 hi = glm::max(glm::max(v[0], v[1]), v[2]);
+
+            // Bounding box inside the tile, starting on a 4 pixel boundary
+            int x0 = std::max(int(std::ceil(lo.x - 0.5f)), tileX);
+            int y0 = std::max(int(std::ceil(lo.y - 0.5f)), tileY);
+            int x1 = std::min({ int(std::floor(hi.x - 0.5f)), tileX + tileSize - 1, width - 1 });
+            int y1 = std::min({ int(std::floor(hi.y - 0.5f)), tileY + tileSize - 1, height - 1 });
+            if (x0 > x1 || y0 > y1) continue;
+            x0 = tileX + ((x0 - tileX) & ~3);
+
+            __m128 stepX[3], bias[3];
+            for (int e = 0; e < 3; e++) {
+                stepX[e] = _mm_mul_ps(_mm_set1_ps(A[e]), laneOffsets);
+                // Excluding 0 on edges that are not top-left: compare w > 0 instead of w >= 0
+                bias[e] = topLeft[e] ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : _mm_setzero_ps();
+            }
+
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f;
+                float* row = tileDepth + (y - tileY) * tileSize - tileX;
+
+                for (int x = x0; x <= x1; x += 4) {
+                    float px = x + 0.5f;
+
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    __m128 w[3];
+                    for (int e = 0; e < 3; e++) {
+                        w[e] = _mm_add_ps(_mm_set1_ps(A[e] * px + B[e] * py + C[e]), stepX[e]);
+                        __m128 positive = _mm_cmpgt_ps(w[e], zero);
+                        __m128 onEdge = _mm_and_ps(_mm_cmpeq_ps(w[e], zero), bias[e]);
+                        inside = _mm_and_ps(inside, _mm_or_ps(positive, onEdge));
+                    }
+
+                    __m128 z = _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(w[0], _mm_set1_ps(depthPlane.x)),
+                        _mm_mul_ps(w[1], _mm_set1_ps(depthPlane.y))),
+                        _mm_mul_ps(w[2], _mm_set1_ps(depthPlane.z)));
+
+                    // Depth clipping and GL_LESS, against what is already in the tile
+                    __m128 current = _mm_loadu_ps(row + x);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(z, zero));
+                    inside = _mm_and_ps(inside, _mm_cmple_ps(z, one));
+                    inside = _mm_and_ps(inside, _mm_cmplt_ps(z, current));
+
+                    // Lanes past the bounding box belong to the next triangle column or the next tile
+                    int lanes = std::min(4, x1 - x + 1);
+                    if (lanes < 4) {
+                        alignas(16) static const int laneMasks[4][4] = {
+                            { -1, 0, 0, 0 }, { -1, -1, 0, 0 }, { -1, -1, -1, 0 }, { -1, -1, -1, -1 }
+                        };
+                        inside = _mm_and_ps(inside, _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(laneMasks[lanes - 1]))));
+                    }
+
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, current)));
+                }
+            }
+        }
+    }
+}
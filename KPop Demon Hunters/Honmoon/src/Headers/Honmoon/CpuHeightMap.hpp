@@ -0,0 +1,65 @@
+#pragma once
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <vector>
+// My headers
+#include "HeightMap.hpp"
+#include "../Model.hpp"
+#include "../Threading/WorkerPool.hpp"
+#include "../Renderer/FramePacket.hpp"
+
+// Software version of the HeightMap depth pass, so the height map can be produced and checked without a GL context.
+// Uses the same top-down orthographic view and writes the same normalized depth the depth texture holds.
+// Triangles are transformed and binned into tiles in parallel, then every tile is rasterized by one thread,
+// four pixels at a time with SSE edge functions. Back faces are culled and ties follow the top-left rule, like GL.
+class CpuHeightMap {
+public:
+    static constexpr int tileSize = 32;
+
+public:
+    CpuHeightMap(int width, int height);
+
+    CpuHeightMap(const CpuHeightMap&) = delete;
+    CpuHeightMap& operator=(const CpuHeightMap&) = delete;
+
+    void resize(int width, int height);
+
+    // Redraws the whole area, there is no caching here
+    void bake(const std::vector<Model>& models, const DrawList& drawList, const HonmoonParams& honmoon, WorkerPool& workers);
+
+    // Row 0 is the bottom row, like the depth texture
+    const std::vector<float>& getDepth() const { return depth; }
+    float getHeight(int x, int y, const HonmoonParams& honmoon) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getTileCount() const { return tilesX * tilesY; }
+
+    // Timing of the last bake, the triangle count includes culled triangles
+    const CpuBakeTiming& getTiming() const { return timing; }
+
+private:
+    // Texel space, x grows with world x, y grows towards -z, d is the normalized depth
+    struct Triangle {
+        glm::vec2 a, b, c;
+        glm::vec3 depth;
+    };
+
+    void transform(const std::vector<Model>& models, const DrawList& drawList, const HonmoonParams& honmoon, WorkerPool& workers);
+    void bin(WorkerPool& workers);
+    void rasterize(WorkerPool& workers);
+    void rasterizeTile(int tile, float* tileDepth) const;
+
+private:
+    int width, height;
+    int tilesX, tilesY;
+    std::vector<float> depth;
+
+    std::vector<Triangle> triangles;
+    std::vector<unsigned char> visible;     // not vector<bool>, chunks write it concurrently
+    std::vector<size_t> itemOffsets;
+    std::vector<std::vector<std::vector<unsigned int>>> bins;   // [chunk][tile], in submission order
+
+    CpuBakeTiming timing;
+};
@@ -0,0 +1,131 @@
+#include "GeodesicField.hpp"
+#include "../Renderer/GLState.hpp"
+#include <algorithm>
+#include <vector>
+
+GeodesicField::GeodesicField(int width, int height, ComputeShader& floodShader)
+    : width(width), height(height), timer(GL_TIME_ELAPSED), floodShader(floodShader)
+{
+    glGenBuffers(1, &rangeBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rangeBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    allocate();
+}
+
+void GeodesicField::resize(int width, int height)
+{
+    if (width == this->width && height == this->height) return;
+
+    this->width = width;
+    this->height = height;
+    allocate();
+}
+
+void GeodesicField::allocate()
+{
+    if (textures[0]) GLState::DeleteTextures(2, textures);
+
+    glGenTextures(2, textures);
+    for (unsigned int texture : textures) {
+        GLState::BindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32F, width, height);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+    valid = false;
+}
+
+bool GeodesicField::update(const HeightField& heightField, const HonmoonParams& honmoon, bool heightFieldChanged)
+{
+    if (timer.poll()) gpuMs = timer.getResult() / 1000000.0f;
+
+    if (valid && !heightFieldChanged && honmoon.patternOrigin == builtOrigin) return false;
+
+    // Texel x grows with world x, texel y grows towards -z
+    glm::vec2 texelSize = glm::vec2(honmoon.size.x / width, honmoon.size.z / height);
+    glm::vec2 originTexel = glm::vec2((honmoon.patternOrigin.x - honmoon.position.x) / texelSize.x,
+                                      (honmoon.position.z + honmoon.size.z - honmoon.patternOrigin.y) / texelSize.y) - 0.5f;
+
+    // An origin outside the area starts from the nearest texel, the flat gap is added on top
+    glm::vec2 clamped = glm::clamp(originTexel, glm::vec2(0.0f), glm::vec2(width - 1, height - 1));
+    float originOffset = glm::length((clamped - originTexel) * texelSize);
+
+    timer.begin();
+
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, rangeBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rangeBuffer);
+
+    floodShader.use();
+    floodShader.setInt("heightField", 0);
+    floodShader.setVec2("originTexel", clamped);
+    floodShader.setFloat("originOffset", originOffset);
+    floodShader.setVec2("texelSize", texelSize);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, heightField.getTexture());
+
+    GLuint groupsX = (width + 7) / 8;
+    GLuint groupsY = (height + 7) / 8;
+
+    // Seed into the first texture, every pass then reads one and writes the other
+    current = 0;
+    floodShader.setBool("seed", true);
+    floodShader.setBool("writeRange", false);
+    glBindImageTexture(0, textures[1], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(1, textures[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+    glDispatchCompute(groupsX, groupsY, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // Halving jumps down to one texel, then the relaxation passes
+    std::vector<int> jumps;
+    int jump = 1;
+    while (jump * 2 < std::max(width, height)) jump *= 2;
+    for (; jump >= 1; jump /= 2) jumps.push_back(jump);
+    jumps.insert(jumps.end(), relaxPasses, 1);
+
+    floodShader.setBool("seed", false);
+
+    for (size_t i = 0; i < jumps.size(); i++) {
+        floodShader.setInt("jump", jumps[i]);
+        floodShader.setBool("writeRange", i + 1 == jumps.size());
+
+        glBindImageTexture(0, textures[current], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        glBindImageTexture(1, textures[current ^ 1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+        glDispatchCompute(groupsX, groupsY, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        current ^= 1;
+    }
+
+    passes = 1 + int(jumps.size());
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+
+    timer.end();
+
+    valid = true;
+    builtOrigin = honmoon.patternOrigin;
+    buildCount++;
+
+    return true;
+}
+
+void GeodesicField::bind(const Shader& shader, int textureUnit) const
+{
+    shader.setBool("useGeodesic", valid);
+
+    GLState::ActiveTexture(GL_TEXTURE0 + textureUnit);
+    GLState::BindTexture(GL_TEXTURE_2D, textures[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rangeBuffer);
+}
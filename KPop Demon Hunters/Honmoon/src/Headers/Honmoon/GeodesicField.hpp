@@ -0,0 +1,61 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// My headers
+#include "HeightField.hpp"
+#include "../Renderer/GpuQuery.hpp"
+#include "../Shaders/Shader.hpp"
+
+// Distance over the Honmoon surface from the pattern origin, one texel per height field texel.
+// Built on the GPU with a jump flood: every pass each texel looks at neighbours half as far away as the
+// pass before and keeps the shortest of going straight on from a neighbour's anchor (the texel its distance
+// was measured from in a straight line) or bending at the neighbour itself, the surface length of each
+// segment read from the height field mips. A few one-texel passes then relax what the long jumps missed.
+// Open ground comes out exact, walls thinner than a mip texel of a long jump are partly smoothed away.
+// Only rebuilt when the height field or the origin changes.
+class GeodesicField {
+public:
+    static constexpr int relaxPasses = 4;
+
+public:
+    GeodesicField(int width, int height, ComputeShader& floodShader);
+
+    GeodesicField(const GeodesicField&) = delete;
+    GeodesicField& operator=(const GeodesicField&) = delete;
+
+    // Reallocates only if the size changed, the next update rebuilds
+    void resize(int width, int height);
+
+    // Returns true if it rebuilt
+    bool update(const HeightField& heightField, const HonmoonParams& honmoon, bool heightFieldChanged);
+    void invalidate() { valid = false; }
+
+    // Sets the geodesic uniforms of Honmoon.frag, binds the field to the given unit and the range buffer
+    void bind(const Shader& shader, int textureUnit) const;
+
+    unsigned int getTexture() const { return textures[current]; }
+    int getPasses() const { return passes; }
+    unsigned int getBuildCount() const { return buildCount; }
+    float getGpuMs() const { return gpuMs; }
+
+private:
+    void allocate();
+
+private:
+    int width, height;
+    unsigned int textures[2] = { 0, 0 };
+    int current = 0;
+    unsigned int rangeBuffer = 0;   // largest distance, read by Honmoon.frag for the sweep
+
+    bool valid = false;
+    glm::vec2 builtOrigin = glm::vec2(0.0f);
+    int passes = 0;
+    unsigned int buildCount = 0;
+
+    GpuQuery timer;     // of a whole build, all relax passes included
+    float gpuMs = 0.0f;
+
+    ComputeShader& floodShader;
+};
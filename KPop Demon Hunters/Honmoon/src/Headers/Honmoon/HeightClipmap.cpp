@@ -0,0 +1,440 @@
+#include "HeightClipmap.hpp"
+#include "../Renderer/GLState.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+HeightClipmap::HeightClipmap(const std::string& cacheDirectory)
+    : cacheDirectory(cacheDirectory), readback(64)
+{
+    std::error_code error;
+    fs::remove_all(cacheDirectory, error);
+    fs::create_directories(cacheDirectory, error);
+    if (error) std::cerr << "Height clipmap cache unavailable: " << cacheDirectory << std::endl;
+
+    glGenTextures(1, &texture);
+    GLState::BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, levelCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+    // Toroidal addressing, the texel after the last one is the first one
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    GLState::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &FBO);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+
+    // no color buffer
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (Level& level : levels) {
+        level.resident.assign(tilesPerSide * tilesPerSide, glm::ivec2(0));
+        level.slotValid.assign(tilesPerSide * tilesPerSide, false);
+        level.slotLoad.assign(tilesPerSide * tilesPerSide, 0);
+    }
+
+    ioThread = std::thread(&HeightClipmap::ioLoop, this);
+}
+
+HeightClipmap::~HeightClipmap()
+{
+    // Whatever is still queued is dropped, the cache is discarded on the next start anyway
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        ioStop = true;
+    }
+    ioCondition.notify_all();
+    ioThread.join();
+}
+
+void HeightClipmap::update(const glm::vec3& cameraPosition, const HonmoonParams& honmoon, float texelSize, int tileBudget,
+                           const DrawList& drawList, const HeightMap::DrawCallback& drawScene)
+{
+    tilesRendered = 0;
+    tilesLoaded = 0;
+
+    // Tiles drawn a few frames ago whose depth has arrived
+    readback.poll(++updateIndex, [this](const AsyncReadback::Result& result) {
+        auto save = pendingSaves.find(result.tag);
+        if (save == pendingSaves.end()) return;
+
+        unsigned long long key = save->second;
+        pendingSaves.erase(save);
+
+        TileIO io;
+        io.op = TileIO::Op::SAVE;
+        io.level = int(key >> 60);
+        io.tile = TileFromKey(key);
+        const float* depth = static_cast<const float*>(result.data);
+        io.depth.assign(depth, depth + size_t(tileSize) * tileSize);
+        queueIO(std::move(io));
+
+        // Queued ahead of any load of it, so the file exists by the time one runs
+        cachedTiles.insert(key);
+    });
+
+    uploadLoadedTiles();
+
+    // Tiles only line up with tiles drawn with the same texel size and the same camera height
+    if (texelSize != this->texelSize || honmoon.center.y != groundHeight) {
+        this->texelSize = texelSize;
+        groundHeight = honmoon.center.y;
+        cameraHeight = groundHeight + HeightMap::yCamOffset;
+        reset();
+    }
+
+    glm::vec2 cameraMap(cameraPosition.x, -cameraPosition.z);
+
+    pending.clear();
+    for (int l = 0; l < levelCount; l++) {
+        Level& level = levels[l];
+
+        glm::ivec2 center = glm::ivec2(glm::floor(cameraMap / levelTileSize(l)));
+        level.window = center - glm::ivec2(tilesPerSide / 2);
+
+        for (int y = 0; y < tilesPerSide; y++) {
+            for (int x = 0; x < tilesPerSide; x++) {
+                glm::ivec2 tile = level.window + glm::ivec2(x, y);
+                int slot = slotIndex(tile);
+                if (level.resident[slot] == tile && (level.slotValid[slot] || level.slotLoad[slot] != 0)) continue;
+
+                glm::ivec2 offset = glm::abs(tile - center);
+                pending.push_back({ l, tile, std::max(offset.x, offset.y) });
+            }
+        }
+    }
+
+    // Finest level first, nearest tiles first within a level
+    std::sort(pending.begin(), pending.end(), [](const PendingTile& a, const PendingTile& b) {
+        return a.level != b.level ? a.level < b.level : a.distance < b.distance;
+    });
+
+    int refreshed = std::min(int(pending.size()), tileBudget);
+    if (refreshed > 0) {
+        // Every graph pass sets its own viewport, so the one changed here is not put back
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, FBO);
+        GLState::Enable(GL_SCISSOR_TEST);
+
+        for (int i = 0; i < refreshed; i++)
+            refreshTile(pending[i].level, pending[i].tile, drawList, drawScene);
+
+        GLState::Disable(GL_SCISSOR_TEST);
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    tilesPending = int(pending.size()) - refreshed;
+
+    for (Level& level : levels) {
+        bool complete = true;
+        for (int y = 0; y < tilesPerSide && complete; y++) {
+            for (int x = 0; x < tilesPerSide && complete; x++) {
+                glm::ivec2 tile = level.window + glm::ivec2(x, y);
+                int slot = slotIndex(tile);
+                complete = level.slotValid[slot] && level.resident[slot] == tile;
+            }
+        }
+
+        if (complete) {
+            level.complete = level.window;
+            level.hasComplete = true;
+        }
+    }
+}
+
+void HeightClipmap::refreshTile(int l, const glm::ivec2& tile, const DrawList& drawList, const HeightMap::DrawCallback& drawScene)
+{
+    Level& level = levels[l];
+    int slot = slotIndex(tile);
+    glm::ivec2 slotTexel = glm::ivec2(slot % tilesPerSide, slot / tilesPerSide) * tileSize;
+
+    level.resident[slot] = tile;
+    level.slotValid[slot] = false;
+    level.slotLoad[slot] = 0;
+
+    // Cached tiles are read on the I/O thread and uploaded when they arrive
+    if (cachedTiles.count(TileKey(l, tile)) != 0) {
+        TileIO io;
+        io.op = TileIO::Op::LOAD;
+        io.level = l;
+        io.tile = tile;
+        io.ticket = nextLoad++;
+        level.slotLoad[slot] = io.ticket;
+        queueIO(std::move(io));
+        return;
+    }
+
+    level.slotValid[slot] = true;
+
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, l);
+    GLState::Viewport(slotTexel.x, slotTexel.y, tileSize, tileSize);
+    glScissor(slotTexel.x, slotTexel.y, tileSize, tileSize);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // Same top-down camera as the height map, over this tile only
+    float size = levelTileSize(l);
+    float minX = tile.x * size;
+    float maxX = minX + size;
+    float maxZ = -tile.y * size;
+    float minZ = maxZ - size;
+
+    glm::vec3 center((minX + maxX) / 2.0f, cameraHeight, (minZ + maxZ) / 2.0f);
+    glm::mat4 view = glm::lookAt(center, center - glm::vec3(0.0f, HeightMap::yCamOffset, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+    glm::mat4 ortho = glm::ortho(-size / 2.0f, size / 2.0f, -size / 2.0f, size / 2.0f, HeightMap::nearPlane, HeightMap::farPlane);
+
+    // One texel of margin, filtering reads across the tile edge
+    float margin = size / tileSize;
+    culled.clear();
+    for (const DrawItem& item : drawList)
+        if (OverlapsXZ(item.worldBounds, minX - margin, minZ - margin, maxX + margin, maxZ + margin))
+            culled.push_back(item);
+
+    if (!culled.empty())
+        drawScene(view, ortho, culled);
+
+    // Saved once the copy lands, the draw above is still queued
+    unsigned long long tag = nextSave++;
+    if (readback.readFramebuffer(FBO, GL_NONE, slotTexel.x, slotTexel.y, tileSize, tileSize, GL_DEPTH_COMPONENT, GL_FLOAT, tag))
+        pendingSaves[tag] = TileKey(l, tile);
+
+    tilesRendered++;
+}
+
+void HeightClipmap::reset()
+{
+    for (Level& level : levels) {
+        std::fill(level.slotValid.begin(), level.slotValid.end(), false);
+        std::fill(level.slotLoad.begin(), level.slotLoad.end(), 0);
+        level.hasComplete = false;
+    }
+
+    for (unsigned long long key : cachedTiles) {
+        TileIO io;
+        io.op = TileIO::Op::REMOVE;
+        io.level = int(key >> 60);
+        io.tile = TileFromKey(key);
+        queueIO(std::move(io));
+    }
+    cachedTiles.clear();
+    pendingSaves.clear();
+}
+
+void HeightClipmap::invalidate(const std::vector<Bounds>& dirtyBounds)
+{
+    // Nothing drawn yet, so nothing to drop (and no tile size to map the bounds with)
+    if (texelSize <= 0.0f) return;
+
+    for (const Bounds& bounds : dirtyBounds)
+        markTiles(bounds);
+}
+
+void HeightClipmap::markTiles(const Bounds& bounds)
+{
+    if (bounds.isEmpty()) return;
+
+    for (int l = 0; l < levelCount; l++) {
+        Level& level = levels[l];
+        float size = levelTileSize(l);
+        float margin = size / tileSize;
+
+        // Map y is -z
+        glm::ivec2 first(int(std::floor((bounds.min.x - margin) / size)), int(std::floor((-bounds.max.z - margin) / size)));
+        glm::ivec2 last(int(std::floor((bounds.max.x + margin) / size)), int(std::floor((-bounds.min.z + margin) / size)));
+
+        for (int y = first.y; y <= last.y; y++) {
+            for (int x = first.x; x <= last.x; x++) {
+                glm::ivec2 tile(x, y);
+                removeTile(l, tile);
+
+                int slot = slotIndex(tile);
+                if (level.resident[slot] == tile) {
+                    level.slotValid[slot] = false;
+                    level.slotLoad[slot] = 0;
+                }
+            }
+        }
+    }
+}
+
+void HeightClipmap::bind(const Shader& shader, int textureUnit) const
+{
+    shader.setInt("clipmapLevelCount", levelCount);
+    shader.setFloat("clipmapResolution", float(resolution));
+    shader.setFloat("clipmapCameraHeight", cameraHeight);
+
+    for (int l = 0; l < levelCount; l++) {
+        const Level& level = levels[l];
+        float size = levelTileSize(l);
+
+        // Only the part of the window whose tiles are all resident, empty if there is none yet
+        glm::vec4 rect(1.0f, 1.0f, 0.0f, 0.0f);
+        if (level.hasComplete) {
+            glm::ivec2 first = glm::max(level.window, level.complete);
+            glm::ivec2 last = glm::min(level.window, level.complete) + glm::ivec2(tilesPerSide);
+            if (first.x < last.x && first.y < last.y)
+                rect = glm::vec4(glm::vec2(first) * size, glm::vec2(last) * size);
+        }
+
+        std::string index = "[" + std::to_string(l) + "]";
+        shader.setVec4("clipmapRects" + index, rect);
+        shader.setFloat("clipmapTexelSize" + index, size / tileSize);
+    }
+
+    GLState::ActiveTexture(GL_TEXTURE0 + textureUnit);
+    GLState::BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
+
+void HeightClipmap::uploadLoadedTiles()
+{
+    std::vector<TileIO> loaded;
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        loaded.swap(ioLoaded);
+    }
+
+    for (TileIO& io : loaded) {
+        Level& level = levels[io.level];
+        int slot = slotIndex(io.tile);
+
+        // The slot moved on or the tile was invalidated while it was read
+        if (level.slotLoad[slot] != io.ticket || level.resident[slot] != io.tile) continue;
+        level.slotLoad[slot] = 0;
+
+        // Drawn on a later update instead
+        if (!io.loaded) {
+            cachedTiles.erase(TileKey(io.level, io.tile));
+            continue;
+        }
+
+        glm::ivec2 slotTexel = glm::ivec2(slot % tilesPerSide, slot / tilesPerSide) * tileSize;
+        GLState::BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, slotTexel.x, slotTexel.y, io.level, tileSize, tileSize, 1, GL_DEPTH_COMPONENT, GL_FLOAT, io.depth.data());
+        GLState::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        level.slotValid[slot] = true;
+        tilesLoaded++;
+    }
+}
+
+void HeightClipmap::queueIO(TileIO io)
+{
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        ioQueue.push_back(std::move(io));
+    }
+    ioCondition.notify_one();
+}
+
+void HeightClipmap::ioLoop()
+{
+    std::unique_lock<std::mutex> lock(ioMutex);
+    while (true) {
+        ioCondition.wait(lock, [this] { return ioStop || !ioQueue.empty(); });
+        if (ioStop) return;
+
+        TileIO io = std::move(ioQueue.front());
+        ioQueue.pop_front();
+        lock.unlock();
+
+        switch (io.op) {
+        case TileIO::Op::LOAD:
+            io.depth.resize(size_t(tileSize) * tileSize);
+            io.loaded = loadTile(io.level, io.tile, io.depth);
+            break;
+        case TileIO::Op::SAVE:
+            saveTile(io.level, io.tile, io.depth);
+            break;
+        case TileIO::Op::REMOVE: {
+            std::error_code error;
+            fs::remove(tilePath(io.level, io.tile), error);
+            break;
+        }
+        }
+
+        lock.lock();
+        if (io.op == TileIO::Op::LOAD) ioLoaded.push_back(std::move(io));
+    }
+}
+
+bool HeightClipmap::loadTile(int level, const glm::ivec2& tile, std::vector<float>& depth) const
+{
+    std::ifstream file(tilePath(level, tile), std::ios::binary);
+    if (!file) return false;
+
+    file.read(reinterpret_cast<char*>(depth.data()), depth.size() * sizeof(float));
+    return bool(file);
+}
+
+void HeightClipmap::saveTile(int level, const glm::ivec2& tile, const std::vector<float>& depth) const
+{
+    std::ofstream file(tilePath(level, tile), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not write height clipmap tile " << tilePath(level, tile) << std::endl;
+        return;
+    }
+
+    file.write(reinterpret_cast<const char*>(depth.data()), depth.size() * sizeof(float));
+}
+
+void HeightClipmap::removeTile(int level, const glm::ivec2& tile)
+{
+    unsigned long long key = TileKey(level, tile);
+
+    // A readback of the old contents may still be in flight
+    for (auto save = pendingSaves.begin(); save != pendingSaves.end();) {
+        if (save->second == key) save = pendingSaves.erase(save);
+        else ++save;
+    }
+
+    if (cachedTiles.erase(key) == 0) return;
+
+    TileIO io;
+    io.op = TileIO::Op::REMOVE;
+    io.level = level;
+    io.tile = tile;
+    queueIO(std::move(io));
+}
+
+int HeightClipmap::slotIndex(const glm::ivec2& tile) const
+{
+    int x = ((tile.x % tilesPerSide) + tilesPerSide) % tilesPerSide;
+    int y = ((tile.y % tilesPerSide) + tilesPerSide) % tilesPerSide;
+    return y * tilesPerSide + x;
+}
+
+std::string HeightClipmap::tilePath(int level, const glm::ivec2& tile) const
+{
+    return (fs::path(cacheDirectory) / ("L" + std::to_string(level) + "_" + std::to_string(tile.x) + "_" + std::to_string(tile.y) + ".depth")).string();
+}
+
+unsigned long long HeightClipmap::TileKey(int level, const glm::ivec2& tile)
+{
+    return (unsigned long long)level << 60
+         | (unsigned long long)(tile.x & 0x3FFFFFFF) << 30
+         | (unsigned long long)(tile.y & 0x3FFFFFFF);
+}
+
+glm::ivec2 HeightClipmap::TileFromKey(unsigned long long key)
+{
+    int x = int((key >> 30) & 0x3FFFFFFF);
+    int y = int(key & 0x3FFFFFFF);
+
+    // Sign extend the 30 bit coordinates
+    if (x & 0x20000000) x -= 0x40000000;
+    if (y & 0x20000000) y -= 0x40000000;
+
+    return glm::ivec2(x, y);
+}
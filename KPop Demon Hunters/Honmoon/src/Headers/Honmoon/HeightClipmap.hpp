@@ -0,0 +1,142 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <unordered_set>
+#include <unordered_map>
+// My headers
+#include "HeightMap.hpp"
+#include "../Renderer/AsyncReadback.hpp"
+#include "../Shaders/Shader.hpp"
+
+// Top-down depth of the scene around the camera, in nested levels that double their texel size.
+// Each level is a layer of a texture array addressed toroidally: a world tile always lands in the
+// same slot (tile index modulo the tiles per side), so when the camera moves only the tiles that
+// enter the window are drawn and nothing is copied around.
+// Every drawn tile is also written to an on-disk cache and read back from it when it comes into view
+// again, until a model moves over it. Drawn tiles reach the cache through an asynchronous readback a few
+// frames later, a tile whose readback finds the ring full is simply not cached. The files are read and
+// written on a thread of their own, a loaded tile is uploaded on the first update after it arrives and
+// drawn instead if its file turns out to be missing. Map space is (x, -z), the same orientation as the height map.
+class HeightClipmap {
+public:
+    static constexpr int levelCount = 4;
+    static constexpr int resolution = 256;                  // texels per side of every level
+    static constexpr int tileSize = 32;
+    static constexpr int tilesPerSide = resolution / tileSize;
+
+public:
+    // Everything already in cacheDirectory is discarded, the scene may have changed since
+    explicit HeightClipmap(const std::string& cacheDirectory);
+
+    ~HeightClipmap();
+
+    HeightClipmap(const HeightClipmap&) = delete;
+    HeightClipmap& operator=(const HeightClipmap&) = delete;
+
+    // Centers every level on the camera and refreshes at most tileBudget tiles, finest level first.
+    // texelSize is the world size of a level 0 texel.
+    void update(const glm::vec3& cameraPosition, const HonmoonParams& honmoon, float texelSize, int tileBudget,
+                const DrawList& drawList, const HeightMap::DrawCallback& drawScene);
+
+    // Drops the resident and cached tiles under the bounds. Needed every frame, updated or not,
+    // or tiles under models that moved while the clipmap was off would come back stale.
+    void invalidate(const std::vector<Bounds>& dirtyBounds);
+
+    // Sets the clipmap uniforms of Honmoon.vert and binds the texture array to the given unit
+    void bind(const Shader& shader, int textureUnit) const;
+
+    unsigned int getTexture() const { return texture; }
+
+    int getTilesRendered() const { return tilesRendered; }
+    int getTilesLoaded() const { return tilesLoaded; }
+    int getTilesPending() const { return tilesPending; }
+    size_t getCachedTiles() const { return cachedTiles.size(); }
+    size_t getCacheBytes() const { return cachedTiles.size() * tileSize * tileSize * sizeof(float); }
+    const AsyncReadback& getReadback() const { return readback; }
+
+private:
+    struct Level {
+        glm::ivec2 window = glm::ivec2(0);      // first tile of the window
+        glm::ivec2 complete = glm::ivec2(0);    // window the last time every slot was up to date
+        bool hasComplete = false;
+        std::vector<glm::ivec2> resident;       // tile held by each slot
+        std::vector<bool> slotValid;
+        std::vector<unsigned long long> slotLoad;   // ticket of the load on its way into each slot, 0 if none
+    };
+
+    struct PendingTile {
+        int level;
+        glm::ivec2 tile;
+        int distance;
+    };
+
+    // Work for the I/O thread, and loads on their way back
+    struct TileIO {
+        enum class Op { LOAD, SAVE, REMOVE };
+        Op op = Op::LOAD;
+        int level = 0;
+        glm::ivec2 tile = glm::ivec2(0);
+        unsigned long long ticket = 0;      // loads only
+        std::vector<float> depth;
+        bool loaded = false;
+    };
+
+    void reset();
+    void markTiles(const Bounds& bounds);
+    void refreshTile(int level, const glm::ivec2& tile, const DrawList& drawList, const HeightMap::DrawCallback& drawScene);
+    void uploadLoadedTiles();
+    void removeTile(int level, const glm::ivec2& tile);
+
+    void queueIO(TileIO io);
+    void ioLoop();
+    bool loadTile(int level, const glm::ivec2& tile, std::vector<float>& depth) const;
+    void saveTile(int level, const glm::ivec2& tile, const std::vector<float>& depth) const;
+
+    float levelTileSize(int level) const { return tileSize * texelSize * float(1 << level); }
+    int slotIndex(const glm::ivec2& tile) const;
+    std::string tilePath(int level, const glm::ivec2& tile) const;
+    static unsigned long long TileKey(int level, const glm::ivec2& tile);
+    static glm::ivec2 TileFromKey(unsigned long long key);
+
+private:
+    std::string cacheDirectory;
+    unsigned int FBO = 0;
+    unsigned int texture = 0;
+
+    Level levels[levelCount];
+    float texelSize = 0.0f;
+    float cameraHeight = 0.0f;
+    float groundHeight = 0.0f;
+
+    std::unordered_set<unsigned long long> cachedTiles;
+    std::vector<PendingTile> pending;
+    DrawList culled;
+    unsigned long long nextLoad = 1;
+
+    // Readbacks in flight, by tag. Tiles invalidated meanwhile are dropped from here so they are never saved.
+    AsyncReadback readback;
+    std::unordered_map<unsigned long long, unsigned long long> pendingSaves;
+    unsigned long long nextSave = 0;
+    unsigned int updateIndex = 0;
+
+    // Taken in order, so a save always lands before a later load or removal of the same tile
+    std::thread ioThread;
+    std::mutex ioMutex;
+    std::condition_variable ioCondition;
+    std::deque<TileIO> ioQueue;
+    std::vector<TileIO> ioLoaded;
+    bool ioStop = false;
+
+    int tilesRendered = 0;
+    int tilesLoaded = 0;
+    int tilesPending = 0;
+};
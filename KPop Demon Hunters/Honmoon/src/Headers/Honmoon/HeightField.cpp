@@ -0,0 +1,180 @@
+#include "HeightField.hpp"
+#include "../Renderer/GLState.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+HeightField::HeightField(int width, int height, ComputeShader& fieldShader, ComputeShader& pyramidShader)
+    : width(width), height(height), rangeReadback(3), fieldShader(fieldShader), pyramidShader(pyramidShader)
+{
+    allocate();
+}
+
+void HeightField::resize(int width, int height)
+{
+    if (width == this->width && height == this->height) return;
+
+    this->width = width;
+    this->height = height;
+    allocate();
+}
+
+void HeightField::allocate()
+{
+    if (texture) GLState::DeleteTextures(1, &texture);
+    if (minMaxTexture) GLState::DeleteTextures(1, &minMaxTexture);
+
+    ranges.clear();
+    rangeWidth = rangeHeight = 0;
+    rangesStale = false;
+    allocation++;
+    generation++;
+
+    levels = 1;
+    while ((std::max(width, height) >> levels) > 0) levels++;
+
+    glGenTextures(1, &texture);
+    GLState::BindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA32F, width, height);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &minMaxTexture);
+    GLState::BindTexture(GL_TEXTURE_2D, minMaxTexture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RG32F, width, height);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
+}
+
+void HeightField::refresh(const HeightMap& heightMap, const HonmoonParams& honmoon)
+{
+    if (heightMap.getUpdatedRects().empty()) return;
+
+    // Normals and curvature read one texel around, so the border of each rect changes too
+    std::vector<TexelRect> rects;
+    for (const TexelRect& rect : heightMap.getUpdatedRects()) {
+        int x0 = std::max(rect.x - 1, 0);
+        int y0 = std::max(rect.y - 1, 0);
+        int x1 = std::min(rect.x + rect.width + 1, width);
+        int y1 = std::min(rect.y + rect.height + 1, height);
+        rects.push_back({ x0, y0, x1 - x0, y1 - y0 });
+    }
+
+    fieldShader.use();
+    fieldShader.setInt("depthMap", 0);
+    fieldShader.setFloat("near", HeightMap::nearPlane);
+    fieldShader.setFloat("far", HeightMap::farPlane);
+    fieldShader.setFloat("cameraHeight", honmoon.center.y + HeightMap::yCamOffset);
+    fieldShader.setVec2("texelSize", honmoon.size.x / heightMap.getWidth(), honmoon.size.z / heightMap.getHeight());
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, heightMap.getTexture());
+    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+    for (const TexelRect& rect : rects) {
+        fieldShader.setiVec2("offset", glm::ivec2(rect.x, rect.y));
+        fieldShader.setiVec2("regionSize", glm::ivec2(rect.width, rect.height));
+
+        glDispatchCompute((rect.width + 7) / 8, (rect.height + 7) / 8, 1);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    GLState::BindTexture(GL_TEXTURE_2D, texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    buildPyramid(rects);
+    requestRanges();
+
+    generation++;
+}
+
+void HeightField::buildPyramid(const std::vector<TexelRect>& rects)
+{
+    pyramidShader.use();
+    pyramidShader.setInt("heightField", 0);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, texture);
+
+    for (int level = 0; level < levels; level++) {
+        int levelWidth = std::max(width >> level, 1);
+        int levelHeight = std::max(height >> level, 1);
+
+        glBindImageTexture(0, minMaxTexture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        glBindImageTexture(1, minMaxTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+        pyramidShader.setInt("level", level);
+
+        for (const TexelRect& rect : rects) {
+            int x0 = rect.x >> level;
+            int y0 = rect.y >> level;
+            int x1 = std::min(((rect.x + rect.width - 1) >> level) + 1, levelWidth);
+            int y1 = std::min(((rect.y + rect.height - 1) >> level) + 1, levelHeight);
+
+            pyramidShader.setiVec2("offset", glm::ivec2(x0, y0));
+            pyramidShader.setiVec2("regionSize", glm::ivec2(x1 - x0, y1 - y0));
+
+            glDispatchCompute((x1 - x0 + 7) / 8, (y1 - y0 + 7) / 8, 1);
+        }
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void HeightField::requestRanges()
+{
+    int level = 0;
+    while (level < levels - 1 && std::max(width >> level, height >> level) > cpuRangeSize) level++;
+
+    // Reading it now would wait for the height pass and the whole pyramid to finish, so it is copied
+    // into a pixel pack buffer and taken a few frames later
+    rangesStale = !rangeReadback.readTexture(minMaxTexture, level, std::max(width >> level, 1), std::max(height >> level, 1), GL_RG, GL_FLOAT, allocation);
+}
+
+void HeightField::pollRanges()
+{
+    // Oldest first, so the newest copy ends up kept
+    rangeReadback.poll(++pollIndex, [this](const AsyncReadback::Result& result) {
+        if (result.tag != allocation) return;
+
+        rangeWidth = result.width;
+        rangeHeight = result.height;
+
+        const glm::vec2* texels = static_cast<const glm::vec2*>(result.data);
+        ranges.assign(texels, texels + size_t(result.width) * result.height);
+    });
+
+    if (rangesStale) requestRanges();
+}
+
+glm::vec2 HeightField::getHeightRange(const glm::vec2& uvMin, const glm::vec2& uvMax) const
+{
+    if (ranges.empty()) return glm::vec2(0.0f);
+
+    // One texel of margin, odd level sizes fold the last row and column into their neighbour
+    int x0 = std::clamp(int(std::floor(uvMin.x * rangeWidth)) - 1, 0, rangeWidth - 1);
+    int y0 = std::clamp(int(std::floor(uvMin.y * rangeHeight)) - 1, 0, rangeHeight - 1);
+    int x1 = std::clamp(int(std::ceil(uvMax.x * rangeWidth)), 0, rangeWidth - 1);
+    int y1 = std::clamp(int(std::ceil(uvMax.y * rangeHeight)), 0, rangeHeight - 1);
+
+    glm::vec2 range(std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            const glm::vec2& texel = ranges[size_t(y) * rangeWidth + x];
+            range.x = std::min(range.x, texel.x);
+            range.y = std::max(range.y, texel.y);
+        }
+    }
+
+    return range;
+}
@@ -0,0 +1,69 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <vector>
+// My headers
+#include "HeightMap.hpp"
+#include "../Renderer/AsyncReadback.hpp"
+#include "../Shaders/Shader.hpp"
+
+// Height map decoded once into what the Honmoon reads per vertex:
+// linear world height, surface normal (x and z, y is implied) and curvature, in one RGBA32F texel.
+// The texture has a full mip chain so the Honmoon can sample it at the LOD of its grid,
+// and a min/max height pyramid (RG32F, one level per mip) answers coarse range queries.
+class HeightField {
+public:
+    HeightField(int width, int height, ComputeShader& fieldShader, ComputeShader& pyramidShader);
+
+    HeightField(const HeightField&) = delete;
+    HeightField& operator=(const HeightField&) = delete;
+
+    // Reallocates only if the size changed, the contents are undefined until the next refresh
+    void resize(int width, int height);
+
+    // Rebuilds the texels the last height map update redrew, plus their neighbours
+    void refresh(const HeightMap& heightMap, const HonmoonParams& honmoon);
+    // Once per frame before refresh: takes the CPU ranges that arrived and retries a dropped request
+    void pollRanges();
+
+    unsigned int getTexture() const { return texture; }
+    unsigned int getMinMaxTexture() const { return minMaxTexture; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getLevels() const { return levels; }
+    // Bumped whenever the texels change, so users that cache what they read can tell they are stale
+    unsigned int getGeneration() const { return generation; }
+
+    // Min and max height under a texture space rect (uv, y = 0 is the bottom row), from a coarse
+    // pyramid level read back asynchronously, so a frame or two behind the GPU after a refresh.
+    // Widened by a texel on each side, which covers both the level's odd sizes and that lag.
+    glm::vec2 getHeightRange(const glm::vec2& uvMin, const glm::vec2& uvMax) const;
+
+    // Largest side of the pyramid level read back after each refresh
+    static constexpr int cpuRangeSize = 64;
+
+private:
+    void allocate();
+    void buildPyramid(const std::vector<TexelRect>& rects);
+    void requestRanges();
+
+private:
+    int width, height;
+    int levels = 1;
+    unsigned int generation = 0;
+    unsigned int texture = 0;
+    unsigned int minMaxTexture = 0;
+
+    int rangeWidth = 0, rangeHeight = 0;
+    std::vector<glm::vec2> ranges;
+    AsyncReadback rangeReadback;
+    unsigned int allocation = 0;    // tags readbacks, those of a texture since reallocated are dropped
+    unsigned int pollIndex = 0;
+    bool rangesStale = false;       // the last request found the ring full
+
+    ComputeShader& fieldShader;
+    ComputeShader& pyramidShader;
+};
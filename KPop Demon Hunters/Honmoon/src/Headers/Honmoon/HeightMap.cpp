@@ -0,0 +1,202 @@
+#include "HeightMap.hpp"
+#include "../Renderer/GLState.hpp"
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+HeightMap::HeightMap(int width, int height)
+    : width(width), height(height), timer(GL_TIME_ELAPSED)
+{
+    glGenFramebuffers(1, &depthMapFBO);
+    glGenTextures(1, &depthMap);
+
+    float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
+    GLState::BindTexture(GL_TEXTURE_2D, depthMap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+    allocate();
+}
+
+void HeightMap::resize(int width, int height)
+{
+    if (width == this->width && height == this->height) return;
+
+    this->width = width;
+    this->height = height;
+    allocate();
+}
+
+void HeightMap::allocate()
+{
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    dirtyTiles.assign(tilesX * tilesY, false);
+    valid = false;
+
+    // create depth texture
+    GLState::BindTexture(GL_TEXTURE_2D, depthMap);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+    // attach to framebuffer
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+
+    // no color buffer
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool HeightMap::update(const HonmoonParams& honmoon, const DrawList& drawList, const std::vector<Bounds>& dirtyBounds, const DrawCallback& drawScene)
+{
+    if (timer.poll()) gpuMs = timer.getResult() / 1000000.0f;
+
+    updatedRects.clear();
+    tilesUpdated = 0;
+
+    if (!valid || honmoon.center != cachedCenter || honmoon.size != cachedSize) {
+        std::fill(dirtyTiles.begin(), dirtyTiles.end(), true);
+    }
+    else {
+        for (const Bounds& bounds : dirtyBounds)
+            markTiles(bounds, honmoon);
+    }
+
+    buildRects();
+    if (updatedRects.empty()) return false;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    timer.begin();
+
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+    GLState::Viewport(0, 0, width, height);
+
+    // Top-down view: camera above the scene, looking down the -Y axis
+    glm::vec3 camPos = honmoon.center + glm::vec3(0.0f, yCamOffset, 0.0f);  // move this up if scene is taller
+    glm::vec3 target = honmoon.center;
+    glm::vec3 upVector = glm::vec3(0.0f, 0.0f, -1.0f); // "up" is -Z when looking down Y
+
+    float orthoSizeX = honmoon.size.x / 2.0f;
+    float orthoSizeZ = honmoon.size.z / 2.0f;
+
+    glm::mat4 view = glm::lookAt(camPos, target, upVector);
+    glm::mat4 ortho = glm::ortho(
+        -orthoSizeX, orthoSizeX,   // left, right
+        -orthoSizeZ, orthoSizeZ,   // bottom, top
+        nearPlane, farPlane
+    );
+
+    // Texel x grows with world x, texel y grows towards -z
+    float left = honmoon.center.x - orthoSizeX;
+    float back = honmoon.center.z + orthoSizeZ;
+    float texelX = honmoon.size.x / width;
+    float texelZ = honmoon.size.z / height;
+
+    GLState::Enable(GL_SCISSOR_TEST);
+
+    for (const TexelRect& rect : updatedRects) {
+        glScissor(rect.x, rect.y, rect.width, rect.height);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        float minX = left + rect.x * texelX;
+        float maxX = left + (rect.x + rect.width) * texelX;
+        float maxZ = back - rect.y * texelZ;
+        float minZ = back - (rect.y + rect.height) * texelZ;
+
+        culled.clear();
+        for (const DrawItem& item : drawList)
+            if (OverlapsXZ(item.worldBounds, minX, minZ, maxX, maxZ))
+                culled.push_back(item);
+
+        if (!culled.empty())
+            drawScene(view, ortho, culled);
+    }
+
+    GLState::Disable(GL_SCISSOR_TEST);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    timer.end();
+
+    cpuMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    valid = true;
+    cachedCenter = honmoon.center;
+    cachedSize = honmoon.size;
+
+    return true;
+}
+
+void HeightMap::readDepth(std::vector<float>& depth) const
+{
+    depth.resize(size_t(width) * height);
+
+    GLState::BindTexture(GL_TEXTURE_2D, depthMap);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
+}
+
+void HeightMap::markTiles(const Bounds& bounds, const HonmoonParams& honmoon)
+{
+    if (bounds.isEmpty()) return;
+
+    float left = honmoon.center.x - honmoon.size.x / 2.0f;
+    float back = honmoon.center.z + honmoon.size.z / 2.0f;
+
+    // One texel of margin so triangles touching the edge are redrawn whole
+    int x0 = static_cast<int>(std::floor((bounds.min.x - left) / honmoon.size.x * width)) - 1;
+    int x1 = static_cast<int>(std::floor((bounds.max.x - left) / honmoon.size.x * width)) + 1;
+    int y0 = static_cast<int>(std::floor((back - bounds.max.z) / honmoon.size.z * height)) - 1;
+    int y1 = static_cast<int>(std::floor((back - bounds.min.z) / honmoon.size.z * height)) + 1;
+
+    if (x1 < 0 || y1 < 0 || x0 >= width || y0 >= height) return;
+
+    int tx0 = std::max(x0, 0) / tileSize;
+    int tx1 = std::min(x1, width - 1) / tileSize;
+    int ty0 = std::max(y0, 0) / tileSize;
+    int ty1 = std::min(y1, height - 1) / tileSize;
+
+    for (int ty = ty0; ty <= ty1; ty++)
+        for (int tx = tx0; tx <= tx1; tx++)
+            dirtyTiles[ty * tilesX + tx] = true;
+}
+
+// Merges dirty tiles into row spans, then stacks spans with the same extent
+void HeightMap::buildRects()
+{
+    for (int ty = 0; ty < tilesY; ty++) {
+        int tx = 0;
+        while (tx < tilesX) {
+            if (!dirtyTiles[ty * tilesX + tx]) { tx++; continue; }
+
+            int start = tx;
+            while (tx < tilesX && dirtyTiles[ty * tilesX + tx]) {
+                dirtyTiles[ty * tilesX + tx] = false;
+                tilesUpdated++;
+                tx++;
+            }
+
+            TexelRect rect;
+            rect.x = start * tileSize;
+            rect.y = ty * tileSize;
+            rect.width = std::min(tx * tileSize, width) - rect.x;
+            rect.height = std::min((ty + 1) * tileSize, height) - rect.y;
+
+            auto above = std::find_if(updatedRects.begin(), updatedRects.end(), [&](const TexelRect& other) {
+                return other.x == rect.x && other.width == rect.width && other.y + other.height == rect.y;
+            });
+
+            if (above != updatedRects.end()) above->height += rect.height;
+            else updatedRects.push_back(rect);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+// Other
+#include <vector>
+#include <functional>
+// My headers
+#include "../Bounds.hpp"
+#include "../Renderer/FramePacket.hpp"
+#include "../Renderer/GpuQuery.hpp"
+
+// Region of the height map in texels, y = 0 is the bottom row
+struct TexelRect {
+    int x, y;
+    int width, height;
+};
+
+// Top-down orthographic depth snapshot of the area covered by the Honmoon.
+// The snapshot is cached and split into tiles. When objects move only the tiles
+// under their old and new bounds are cleared and redrawn, with the objects touching them.
+class HeightMap {
+public:
+    // Draws the given items with the top-down view and projection
+    using DrawCallback = std::function<void(const glm::mat4& view, const glm::mat4& projection, const DrawList& drawList)>;
+
+    static constexpr float nearPlane = 0.1f;
+    static constexpr float farPlane = 100.0f;
+    static constexpr float yCamOffset = 50.0f;
+
+    static constexpr int tileSize = 16;
+
+public:
+    HeightMap(int width, int height);
+
+    HeightMap(const HeightMap&) = delete;
+    HeightMap& operator=(const HeightMap&) = delete;
+
+    // Reallocates only if the size changed, the next update redraws everything
+    void resize(int width, int height);
+
+    // Redraws everything if the Honmoon area changed, otherwise only the tiles under dirtyBounds.
+    // Returns true if anything was drawn.
+    bool update(const HonmoonParams& honmoon, const DrawList& drawList, const std::vector<Bounds>& dirtyBounds, const DrawCallback& drawScene);
+    void invalidate() { valid = false; }
+
+    unsigned int getTexture() const { return depthMap; }
+    // Synchronous copy of the whole depth texture, row 0 is the bottom row
+    void readDepth(std::vector<float>& depth) const;
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Regions redrawn by the last update, for anything derived from the height map
+    const std::vector<TexelRect>& getUpdatedRects() const { return updatedRects; }
+    int getTileCount() const { return tilesX * tilesY; }
+    int getTilesUpdated() const { return tilesUpdated; }
+
+    // Cost of the last regeneration, which is what a cached frame saves
+    float getCpuMs() const { return cpuMs; }
+    float getGpuMs() const { return gpuMs; }
+
+private:
+    void allocate();
+    void markTiles(const Bounds& bounds, const HonmoonParams& honmoon);
+    void buildRects();
+
+private:
+    int width, height;
+    int tilesX, tilesY;
+    unsigned int depthMapFBO = 0;
+    unsigned int depthMap = 0;
+
+    bool valid = false;
+    glm::vec3 cachedCenter = glm::vec3(0.0f);
+    glm::vec3 cachedSize = glm::vec3(0.0f);
+
+    std::vector<bool> dirtyTiles;
+    std::vector<TexelRect> updatedRects;
+    int tilesUpdated = 0;
+    DrawList culled;
+
+    GpuQuery timer;     // regenerations while a result is pending are not timed
+    float cpuMs = 0.0f;
+    float gpuMs = 0.0f;
+};
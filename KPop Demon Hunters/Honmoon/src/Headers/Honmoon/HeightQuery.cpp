@@ -0,0 +1,312 @@
+#include "HeightQuery.hpp"
+#include "HeightMap.hpp"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// AVX2 code is compiled for every build and only called when the CPU supports it
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+void HeightQuery::build(const std::vector<float>& depth, int width, int height, const HonmoonParams& honmoon)
+{
+    origin = honmoon.position;
+    size = honmoon.size;
+
+    levels.clear();
+    if (width <= 0 || height <= 0 || depth.size() < size_t(width) * height) return;
+
+    // Level 0, same decode and differences as HeightField.comp
+    float cameraHeight = honmoon.center.y + HeightMap::yCamOffset;
+    glm::vec2 texelSize(size.x / width, size.z / height);
+
+    auto worldHeight = [&](int x, int y) {
+        x = std::clamp(x, 0, width - 1);
+        y = std::clamp(y, 0, height - 1);
+        return cameraHeight - (depth[size_t(y) * width + x] * (HeightMap::farPlane - HeightMap::nearPlane) + HeightMap::nearPlane);
+    };
+
+    Level base;
+    base.width = width;
+    base.height = height;
+    base.heights.resize(size_t(width) * height);
+    base.normalX.resize(base.heights.size());
+    base.normalZ.resize(base.heights.size());
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float H0 = worldHeight(x, y);
+            float dHdx = (worldHeight(x + 1, y) - H0) / texelSize.x;
+            float dHdz = -(worldHeight(x, y + 1) - H0) / texelSize.y;
+            glm::vec3 normal = glm::normalize(glm::vec3(-dHdx, 1.0f, -dHdz));
+
+            size_t i = size_t(y) * width + x;
+            base.heights[i] = H0;
+            base.normalX[i] = normal.x;
+            base.normalZ[i] = normal.z;
+        }
+    }
+
+    levels.push_back(std::move(base));
+
+    // 2x2 box filter down to 1x1, like the HeightField mip chain
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level& source = levels.back();
+        Level level;
+        level.width = std::max(source.width / 2, 1);
+        level.height = std::max(source.height / 2, 1);
+        size_t count = size_t(level.width) * level.height;
+        level.heights.resize(count);
+        level.normalX.resize(count);
+        level.normalZ.resize(count);
+
+        for (int y = 0; y < level.height; y++) {
+            for (int x = 0; x < level.width; x++) {
+                int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+                int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+                size_t a = size_t(y0) * source.width + x0, b = size_t(y0) * source.width + x1;
+                size_t c = size_t(y1) * source.width + x0, d = size_t(y1) * source.width + x1;
+
+                size_t i = size_t(y) * level.width + x;
+                level.heights[i] = (source.heights[a] + source.heights[b] + source.heights[c] + source.heights[d]) * 0.25f;
+                level.normalX[i] = (source.normalX[a] + source.normalX[b] + source.normalX[c] + source.normalX[d]) * 0.25f;
+                level.normalZ[i] = (source.normalZ[a] + source.normalZ[b] + source.normalZ[c] + source.normalZ[d]) * 0.25f;
+            }
+        }
+
+        levels.push_back(std::move(level));
+    }
+}
+
+bool HeightQuery::contains(float x, float z) const
+{
+    return x >= origin.x && x <= origin.x + size.x && z >= origin.z && z <= origin.z + size.z;
+}
+
+glm::vec3 HeightQuery::bilinear(const Level& level, glm::vec2 uv) const
+{
+    // GL_LINEAR with GL_CLAMP_TO_EDGE
+    float u = uv.x * level.width - 0.5f;
+    float v = uv.y * level.height - 0.5f;
+    float fu = std::floor(u), fv = std::floor(v);
+    float tu = u - fu, tv = v - fv;
+
+    int x0 = std::clamp(int(fu), 0, level.width - 1), x1 = std::clamp(int(fu) + 1, 0, level.width - 1);
+    int y0 = std::clamp(int(fv), 0, level.height - 1), y1 = std::clamp(int(fv) + 1, 0, level.height - 1);
+
+    auto texel = [&](int x, int y) {
+        size_t i = size_t(y) * level.width + x;
+        return glm::vec3(level.heights[i], level.normalX[i], level.normalZ[i]);
+    };
+
+    glm::vec3 bottom = glm::mix(texel(x0, y0), texel(x1, y0), tu);
+    glm::vec3 top = glm::mix(texel(x0, y1), texel(x1, y1), tu);
+    return glm::mix(bottom, top, tv);
+}
+
+glm::vec3 HeightQuery::fetch(float x, float z) const
+{
+    // Grid coordinates, then the same flip as Honmoon.vert
+    glm::vec2 uv((x - origin.x) / size.x, 1.0f - (z - origin.z) / size.z);
+
+    float clamped = std::clamp(lod, 0.0f, float(levels.size() - 1));
+    int level = int(clamped);
+    glm::vec3 field = bilinear(levels[level], uv);
+
+    if (level + 1 < int(levels.size()) && clamped > level)
+        field = glm::mix(field, bilinear(levels[level + 1], uv), clamped - level);
+
+    return field;
+}
+
+SurfaceSample HeightQuery::displace(float x, float z, const glm::vec3& field) const
+{
+    float ny = std::sqrt(std::max(1.0f - field.y * field.y - field.z * field.z, 0.0f));
+    glm::vec3 normal = glm::normalize(glm::vec3(field.y, ny, field.z));
+
+    SurfaceSample sample;
+    sample.position = glm::vec3(x, field.x, z) + normal * hoverHeight;
+    sample.normal = normal;
+    return sample;
+}
+
+SurfaceSample HeightQuery::sample(float x, float z) const
+{
+    if (levels.empty()) return { glm::vec3(x, 0.0f, z), glm::vec3(0.0f, 1.0f, 0.0f) };
+    return displace(x, z, fetch(x, z));
+}
+
+void HeightQuery::sample(const float* x, const float* z, size_t count, SurfaceSample* results) const
+{
+    if (levels.empty()) {
+        sampleScalar(x, z, count, results);
+        return;
+    }
+
+    static const bool avx2 = HasAVX2();
+
+    // Trilinear samples stay scalar, the grid normally runs at the map's own resolution
+    if (avx2 && std::floor(lod) == lod) sampleAVX2(x, z, count, results);
+    else sampleScalar(x, z, count, results);
+}
+
+void HeightQuery::sampleScalar(const float* x, const float* z, size_t count, SurfaceSample* results) const
+{
+    for (size_t i = 0; i < count; i++)
+        results[i] = sample(x[i], z[i]);
+}
+
+// 8 bilinear lookups, same operation order as glm::mix in the scalar path
+TARGET_AVX2 static inline __m256 Bilinear8(const float* data, __m256i i00, __m256i i10, __m256i i01, __m256i i11, __m256 tu, __m256 tv)
+{
+    __m256 a = _mm256_i32gather_ps(data, i00, 4), b = _mm256_i32gather_ps(data, i10, 4);
+    __m256 c = _mm256_i32gather_ps(data, i01, 4), d = _mm256_i32gather_ps(data, i11, 4);
+    __m256 bottom = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), tu));
+    __m256 top = _mm256_add_ps(c, _mm256_mul_ps(_mm256_sub_ps(d, c), tu));
+    return _mm256_add_ps(bottom, _mm256_mul_ps(_mm256_sub_ps(top, bottom), tv));
+}
+
+TARGET_AVX2 void HeightQuery::sampleAVX2(const float* x, const float* z, size_t count, SurfaceSample* results) const
+{
+    const Level& level = levels[std::clamp(int(lod), 0, int(levels.size()) - 1)];
+
+    const __m256 originX = _mm256_set1_ps(origin.x), originZ = _mm256_set1_ps(origin.z);
+    const __m256 scaleU = _mm256_set1_ps(level.width / size.x);
+    const __m256 scaleV = _mm256_set1_ps(level.height / size.z);
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    const __m256 levelHeight = _mm256_set1_ps(float(level.height));
+    const __m256i maxX = _mm256_set1_epi32(level.width - 1), maxY = _mm256_set1_epi32(level.height - 1);
+    const __m256i stride = _mm256_set1_epi32(level.width);
+    const __m256i zeroi = _mm256_setzero_si256(), onei = _mm256_set1_epi32(1);
+    const __m256 hover = _mm256_set1_ps(hoverHeight);
+
+    alignas(32) float px[8], py[8], pz[8], nx[8], ny[8], nz[8];
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 wx = _mm256_loadu_ps(x + i);
+        __m256 wz = _mm256_loadu_ps(z + i);
+
+        // u = uv.x * width - 0.5, v = (1 - t.z) * height - 0.5
+        __m256 u = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(wx, originX), scaleU), half);
+        __m256 v = _mm256_sub_ps(_mm256_sub_ps(levelHeight, _mm256_mul_ps(_mm256_sub_ps(wz, originZ), scaleV)), half);
+
+        __m256 fu = _mm256_floor_ps(u), fv = _mm256_floor_ps(v);
+        __m256 tu = _mm256_sub_ps(u, fu), tv = _mm256_sub_ps(v, fv);
+
+        __m256i iu = _mm256_cvtps_epi32(fu), iv = _mm256_cvtps_epi32(fv);
+        __m256i x0 = _mm256_min_epi32(_mm256_max_epi32(iu, zeroi), maxX);
+        __m256i x1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(iu, onei), zeroi), maxX);
+        __m256i y0 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(iv, zeroi), maxY), stride);
+        __m256i y1 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(iv, onei), zeroi), maxY), stride);
+
+        __m256i i00 = _mm256_add_epi32(y0, x0), i10 = _mm256_add_epi32(y0, x1);
+        __m256i i01 = _mm256_add_epi32(y1, x0), i11 = _mm256_add_epi32(y1, x1);
+
+        __m256 h = Bilinear8(level.heights.data(), i00, i10, i01, i11, tu, tv);
+        __m256 fx = Bilinear8(level.normalX.data(), i00, i10, i01, i11, tu, tv);
+        __m256 fz = Bilinear8(level.normalZ.data(), i00, i10, i01, i11, tu, tv);
+
+        // normalize(vec3(g, sqrt(max(1 - g^2 - b^2, 0)), b))
+        __m256 fy = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_sub_ps(one, _mm256_mul_ps(fx, fx)), _mm256_mul_ps(fz, fz)), zero));
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(fx, fx), _mm256_mul_ps(fy, fy)), _mm256_mul_ps(fz, fz)));
+        __m256 inverse = _mm256_div_ps(one, length);
+        fx = _mm256_mul_ps(fx, inverse);
+        fy = _mm256_mul_ps(fy, inverse);
+        fz = _mm256_mul_ps(fz, inverse);
+
+        _mm256_store_ps(px, _mm256_add_ps(wx, _mm256_mul_ps(fx, hover)));
+        _mm256_store_ps(py, _mm256_add_ps(h, _mm256_mul_ps(fy, hover)));
+        _mm256_store_ps(pz, _mm256_add_ps(wz, _mm256_mul_ps(fz, hover)));
+        _mm256_store_ps(nx, fx);
+        _mm256_store_ps(ny, fy);
+        _mm256_store_ps(nz, fz);
+
+        for (int lane = 0; lane < 8; lane++) {
+            results[i + lane].position = glm::vec3(px[lane], py[lane], pz[lane]);
+            results[i + lane].normal = glm::vec3(nx[lane], ny[lane], nz[lane]);
+        }
+    }
+
+    sampleScalar(x + i, z + i, count - i, results + i);
+}
+
+bool HeightQuery::HasAVX2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool HeightQuery::raycast(const glm::vec3& rayOrigin, const glm::vec3& direction, float maxDistance, SurfaceSample& hit) const
+{
+    if (levels.empty()) return false;
+
+    glm::vec3 dir = glm::normalize(direction);
+
+    // Clip the ray to the Honmoon area seen from above
+    float enter = 0.0f, exit = maxDistance;
+    for (int axis : { 0, 2 }) {
+        float lo = origin[axis], hi = origin[axis] + size[axis];
+        if (std::abs(dir[axis]) < 1e-8f) {
+            if (rayOrigin[axis] < lo || rayOrigin[axis] > hi) return false;
+            continue;
+        }
+
+        float t0 = (lo - rayOrigin[axis]) / dir[axis];
+        float t1 = (hi - rayOrigin[axis]) / dir[axis];
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    if (enter > exit) return false;
+
+    // Above the surface is positive, the sideways hover offset is left out of the crossing test
+    auto above = [&](float t) {
+        glm::vec3 p = rayOrigin + dir * t;
+        return p.y - sample(p.x, p.z).position.y;
+    };
+
+    const Level& base = levels[0];
+    float step = 0.5f * std::min(size.x / base.width, size.z / base.height) / std::max(glm::length(glm::vec2(dir.x, dir.z)), 1e-3f);
+    step = std::max(step, 1e-4f);
+
+    float previousT = enter;
+    if (above(enter) <= 0.0f) return false;    // starts below the surface
+
+    for (float t = enter + step; t <= exit + step; t += step) {
+        t = std::min(t, exit);
+        float current = above(t);
+
+        if (current <= 0.0f) {
+            // Bisect between the last point above and the first point below
+            float lo = previousT, hi = t;
+            for (int i = 0; i < 16; i++) {
+                float mid = (lo + hi) * 0.5f;
+                if (above(mid) > 0.0f) lo = mid;
+                else hi = mid;
+            }
+
+            glm::vec3 p = rayOrigin + dir * hi;
+            hit = sample(p.x, p.z);
+            return true;
+        }
+
+        if (t >= exit) break;
+        previousT = t;
+    }
+
+    return false;
+}
@@ -0,0 +1,64 @@
+#pragma once
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <vector>
+// My headers
+#include "../Renderer/FramePacket.hpp"
+
+// Point on the displaced Honmoon surface
+struct SurfaceSample {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+// CPU copy of the Honmoon height data for gameplay and effect code, no GPU readback involved.
+// Built from a normalized top-down depth map (the GPU one or CpuHeightMap's), decoded exactly like
+// HeightField.comp, with box filtered mips standing in for glGenerateMipmap.
+// Sampling follows Honmoon.vert: bilinear (trilinear between mips) at the grid's LOD, then the
+// hover offset along the filtered normal. A sample at (x, z) is where Honmoon.vert would put a
+// vertex whose grid position is (x, z), so its position is moved sideways by the hover offset too.
+class HeightQuery {
+public:
+    // Depth rows start at the bottom, like the depth texture
+    void build(const std::vector<float>& depth, int width, int height, const HonmoonParams& honmoon);
+
+    // Same value Honmoon.vert gets as heightLod, and the hover height it displaces by
+    void setLod(float lod) { this->lod = lod; }
+    void setHoverHeight(float hoverHeight) { this->hoverHeight = hoverHeight; }
+
+    bool isEmpty() const { return levels.empty(); }
+    bool contains(float x, float z) const;
+
+    SurfaceSample sample(float x, float z) const;
+
+    // Thousands of points at once, 8 per step with AVX2 when the CPU has it
+    void sample(const float* x, const float* z, size_t count, SurfaceSample* results) const;
+    static bool HasAVX2();
+
+    // First hit along the ray within maxDistance, marched half a texel at a time then refined
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, SurfaceSample& hit) const;
+
+private:
+    struct Level {
+        int width = 0, height = 0;
+        std::vector<float> heights;     // world height
+        std::vector<float> normalX;
+        std::vector<float> normalZ;
+    };
+
+    // Filtered height and normal x/z, before the hover offset
+    glm::vec3 fetch(float x, float z) const;
+    glm::vec3 bilinear(const Level& level, glm::vec2 uv) const;
+    SurfaceSample displace(float x, float z, const glm::vec3& field) const;
+
+    void sampleScalar(const float* x, const float* z, size_t count, SurfaceSample* results) const;
+    void sampleAVX2(const float* x, const float* z, size_t count, SurfaceSample* results) const;
+
+private:
+    std::vector<Level> levels;
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 size = glm::vec3(0.0f);
+    float lod = 0.0f;
+    float hoverHeight = 0.0f;
+};
@@ -0,0 +1,75 @@
+#include "HonmoonBarriers.hpp"
+#include "../Renderer/GLState.hpp"
+#include <algorithm>
+#include <chrono>
+
+HonmoonBarriers::HonmoonBarriers(int gridSize)
+    : gridSize(std::max(gridSize, 2))
+{
+    glGenBuffers(1, &SSBO);
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+bool HonmoonBarriers::update(const std::shared_ptr<const BarrierList>& barriers, const HonmoonParams& honmoon)
+{
+    if (barriers == uploaded && honmoon.position == uploadedPosition && honmoon.size == uploadedSize) return false;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uploaded = barriers;
+    uploadedPosition = honmoon.position;
+    uploadedSize = honmoon.size;
+    count = barriers ? barriers->size() : 0;
+
+    staging.clear();
+    staging.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const HonmoonBarrier& barrier = (*barriers)[i];
+
+        // Region of the height field under the barrier, before the flip Honmoon.vert applies
+        glm::vec2 areaMin(honmoon.position.x, honmoon.position.z);
+        glm::vec2 areaSize(std::max(honmoon.size.x, 1e-6f), std::max(honmoon.size.z, 1e-6f));
+        glm::vec2 uvMin = glm::clamp((glm::vec2(barrier.position.x, barrier.position.z) - areaMin) / areaSize, 0.0f, 1.0f);
+        glm::vec2 uvMax = glm::clamp((glm::vec2(barrier.position.x + barrier.size.x, barrier.position.z + barrier.size.z) - areaMin) / areaSize, 0.0f, 1.0f);
+
+        GpuBarrier gpu;
+        gpu.positionHover = glm::vec4(barrier.position, barrier.hoverHeight);
+        gpu.sizeThickness = glm::vec4(barrier.size, barrier.thickness);
+        gpu.pattern = glm::vec4(barrier.patternOrigin, barrier.spacing, barrier.progress);
+        gpu.color1 = barrier.color1;
+        gpu.color2 = barrier.color2;
+        gpu.atlasRect = glm::vec4(uvMin, uvMax);
+        staging.push_back(gpu);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+    if (count > capacity) {
+        capacity = count;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(GpuBarrier), staging.data(), GL_DYNAMIC_DRAW);
+    }
+    else if (count > 0) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GpuBarrier), staging.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    uploadCount++;
+    uploadMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    return true;
+}
+
+void HonmoonBarriers::Draw(const Shader& shader) const
+{
+    if (count == 0) return;
+
+    shader.setInt("gridMode", 3);
+    shader.setVec2("gridSize", glm::vec2(gridSize));
+
+    // One instance per barrier, 6 vertices per quad, same quads as the procedural grid
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO);
+    GLState::BindVertexArray(emptyVAO);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6 * (gridSize - 1) * (gridSize - 1), GLsizei(count));
+    GLState::BindVertexArray(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+}
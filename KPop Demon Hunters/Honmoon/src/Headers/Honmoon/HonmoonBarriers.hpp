@@ -0,0 +1,64 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <algorithm>
+#include <memory>
+#include <vector>
+// My headers
+#include "../Shaders/Shader.hpp"
+#include "../Renderer/FramePacket.hpp"
+
+// Any number of extra Honmoon barriers drawn with one instanced call.
+// Their parameters live in a storage buffer, one entry per instance, and every instance runs the same
+// procedural grid through Honmoon.vert (gridMode 3). Each entry carries the region of the shared height
+// field under the barrier, so the height field doubles as the atlas and nothing is drawn per barrier.
+// The CPU only touches the list when a new one is handed over.
+class HonmoonBarriers {
+public:
+    explicit HonmoonBarriers(int gridSize);
+
+    HonmoonBarriers(const HonmoonBarriers&) = delete;
+    HonmoonBarriers& operator=(const HonmoonBarriers&) = delete;
+
+    void setGridSize(int gridSize) { this->gridSize = std::max(gridSize, 2); }
+
+    // Uploads the list if it is not the one already on the GPU or the Honmoon area moved.
+    // Returns true if it uploaded.
+    bool update(const std::shared_ptr<const BarrierList>& barriers, const HonmoonParams& honmoon);
+
+    // Expects Honmoon.vert to be bound and the height field on its unit
+    void Draw(const Shader& shader) const;
+
+    size_t getCount() const { return count; }
+    size_t getBufferBytes() const { return capacity * sizeof(GpuBarrier); }
+    unsigned int getUploadCount() const { return uploadCount; }
+    float getUploadMs() const { return uploadMs; }
+
+private:
+    // Matches the Barrier struct of Honmoon.vert and Honmoon.frag, std430
+    struct GpuBarrier {
+        glm::vec4 positionHover;    // xyz corner, w hover height
+        glm::vec4 sizeThickness;    // xyz size, w ring thickness
+        glm::vec4 pattern;          // xy ring origin (x, z), z spacing, w progress
+        glm::vec4 color1;
+        glm::vec4 color2;
+        glm::vec4 atlasRect;        // height field uv under the barrier, min.xy max.zw
+    };
+
+    int gridSize;
+    unsigned int SSBO = 0;
+    unsigned int emptyVAO = 0;      // core profile still needs a VAO bound to draw
+    size_t capacity = 0;
+    size_t count = 0;
+
+    std::shared_ptr<const BarrierList> uploaded;
+    glm::vec3 uploadedPosition = glm::vec3(0.0f);
+    glm::vec3 uploadedSize = glm::vec3(0.0f);
+    std::vector<GpuBarrier> staging;
+
+    unsigned int uploadCount = 0;
+    float uploadMs = 0.0f;
+};
@@ -0,0 +1,192 @@
+#include "HonmoonGrid.hpp"
+#include "../Renderer/GLState.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+HonmoonGrid::HonmoonGrid(int gridSizeX, int gridSizeZ, ComputeShader& bakeShader)
+    : gridSizeX(gridSizeX), gridSizeZ(gridSizeZ), bakeShader(bakeShader)
+{
+    glGenVertexArrays(1, &VAO);
+    glGenVertexArrays(1, &emptyVAO);
+    glGenVertexArrays(1, &bakedVAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    build();
+}
+
+void HonmoonGrid::resize(int gridSizeX, int gridSizeZ)
+{
+    if (gridSizeX == this->gridSizeX && gridSizeZ == this->gridSizeZ) return;
+
+    this->gridSizeX = gridSizeX;
+    this->gridSizeZ = gridSizeZ;
+    if (mode != Mode::PROCEDURAL) build();
+}
+
+void HonmoonGrid::setMode(Mode mode)
+{
+    if (mode == this->mode) return;
+
+    this->mode = mode;
+    if (mode == Mode::PROCEDURAL) release();
+    else build();
+}
+
+size_t HonmoonGrid::BufferedBytes(int gridSizeX, int gridSizeZ, Mode mode)
+{
+    if (mode == Mode::PROCEDURAL) return 0;
+
+    size_t vertices = size_t(gridSizeX + 1) * size_t(gridSizeZ + 1);
+    size_t indices = gridSizeX > 1 && gridSizeZ > 1 ? 6 * size_t(gridSizeX - 1) * size_t(gridSizeZ - 1) : 0;
+    size_t vertexSize = mode == Mode::BAKED ? sizeof(BakedVertex) : sizeof(HonmoonVertex);
+    return vertices * vertexSize + indices * sizeof(GLuint);
+}
+
+void HonmoonGrid::release()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    indexCount = 0;
+    buildMs = 0.0f;
+    bakeValid = false;
+}
+
+void HonmoonGrid::build()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<GLuint> indices;
+    int meshWidth = gridSizeX + 1;
+
+    for (int z = 0; z < gridSizeZ - 1; z++) {  // skip last row
+        for (int x = 0; x < gridSizeX - 1; x++) {  // skip last column
+            int i0 = z * meshWidth + x;
+            int i1 = i0 + 1;
+            int i2 = i0 + meshWidth;
+            int i3 = i2 + 1;
+
+            // two triangles per quad
+            indices.push_back(i0);
+            indices.push_back(i2);
+            indices.push_back(i1);
+
+            indices.push_back(i1);
+            indices.push_back(i2);
+            indices.push_back(i3);
+        }
+    }
+
+    indexCount = indices.size();
+    size_t vertexCount = size_t(gridSizeX + 1) * size_t(gridSizeZ + 1);
+
+    if (mode == Mode::BAKED) {
+        // Filled by the next bake, the compute pass writes it as a storage buffer
+        GLState::BindVertexArray(bakedVAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(BakedVertex) * vertexCount, nullptr, GL_DYNAMIC_COPY);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0); // Position
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(BakedVertex), (void*)0);
+        glEnableVertexAttribArray(1); // Normal
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(BakedVertex), (void*)offsetof(BakedVertex, normal));
+
+        GLState::BindVertexArray(0);
+
+        bakeValid = false;
+    }
+    else {
+        std::vector<HonmoonVertex> vertices;
+        vertices.reserve(vertexCount);
+
+        for (int z = 0; z <= gridSizeZ; z++) {
+            for (int x = 0; x <= gridSizeX; x++) {
+                glm::vec2 texCoord = glm::vec2(x, z) / glm::vec2(gridSizeX, gridSizeZ);
+                vertices.push_back({ texCoord });
+            }
+        }
+
+        GLState::BindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(HonmoonVertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0); // Position
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HonmoonVertex), (void*)0);
+
+        GLState::BindVertexArray(0);
+    }
+
+    buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool HonmoonGrid::bake(const HonmoonParams& honmoon, const HeightField& heightField)
+{
+    if (mode != Mode::BAKED) return false;
+
+    if (bakeValid && heightField.getGeneration() == bakedGeneration && honmoon.position == bakedPosition && honmoon.size == bakedSize && honmoon.hoverHeight == bakedHoverHeight)
+        return false;
+
+    float texelsPerCell = heightField.getWidth() / (float)gridSizeX;
+
+    bakeShader.use();
+    bakeShader.setInt("heightField", 0);
+    bakeShader.setFloat("hoverHeight", honmoon.hoverHeight);
+    bakeShader.setVec3("origin", honmoon.position);
+    bakeShader.setVec3("size", honmoon.size);
+    bakeShader.setiVec2("gridSize", glm::ivec2(gridSizeX, gridSizeZ));
+    bakeShader.setFloat("heightLod", std::max(std::log2(texelsPerCell), 0.0f));
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, heightField.getTexture());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, VBO);
+
+    glDispatchCompute((gridSizeX + 1 + 7) / 8, (gridSizeZ + 1 + 7) / 8, 1);
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+
+    bakeValid = true;
+    bakedPosition = honmoon.position;
+    bakedSize = honmoon.size;
+    bakedHoverHeight = honmoon.hoverHeight;
+    bakedGeneration = heightField.getGeneration();
+    bakeCount++;
+
+    return true;
+}
+
+void HonmoonGrid::Draw(const Shader& shader) const
+{
+    if (mode == Mode::PROCEDURAL) {
+        shader.setInt("gridMode", 1);
+
+        // One instance per row, 6 vertices per quad, same quads as the buffered index list
+        if (gridSizeX < 2 || gridSizeZ < 2) return;
+
+        GLState::BindVertexArray(emptyVAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6 * (gridSizeX - 1), gridSizeZ - 1);
+        GLState::BindVertexArray(0);
+        return;
+    }
+
+    if (mode == Mode::BUFFERED) shader.setInt("gridMode", 0);
+
+    GLState::BindVertexArray(mode == Mode::BAKED ? bakedVAO : VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
+    GLState::BindVertexArray(0);
+}
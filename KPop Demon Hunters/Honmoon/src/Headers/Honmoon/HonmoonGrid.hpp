@@ -0,0 +1,86 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// My headers
+#include "HeightField.hpp"
+#include "../Shaders/Shader.hpp"
+#include "../Renderer/FramePacket.hpp"
+// Other
+#include <vector>
+
+// Flat grid covering the Honmoon area, in one of three modes:
+// BUFFERED uploads (N+1)^2 texture coordinates and 6(N-1)^2 indices, Honmoon.vert displaces them every frame.
+// PROCEDURAL has no buffers at all, Honmoon.vert derives the coordinates from gl_VertexID and gl_InstanceID
+// so the size is only a pair of uniforms.
+// BAKED keeps the indices and lets HonmoonBake.comp write displaced positions and normals into the vertex
+// buffer whenever the height field or the placement changes, HonmoonBaked.vert only projects them.
+class HonmoonGrid {
+public:
+    enum class Mode {
+        BUFFERED,
+        PROCEDURAL,
+        BAKED
+    };
+
+public:
+    HonmoonGrid(int gridSizeX, int gridSizeZ, ComputeShader& bakeShader);
+
+    HonmoonGrid(const HonmoonGrid&) = delete;
+    HonmoonGrid& operator=(const HonmoonGrid&) = delete;
+
+    // Buffered and baked modes reallocate only if the size changed, procedural mode never does
+    void resize(int gridSizeX, int gridSizeZ);
+    void setMode(Mode mode);
+
+    // Baked mode only, reruns the bake if the grid, the placement or the height field changed since the
+    // last one, however many frames ago that was. Returns true if it ran.
+    bool bake(const HonmoonParams& honmoon, const HeightField& heightField);
+
+    // Expects Honmoon.vert to be bound, or HonmoonBaked.vert in baked mode
+    void Draw(const Shader& shader) const;
+
+    int getSizeX() const { return gridSizeX; }
+    int getSizeZ() const { return gridSizeZ; }
+    Mode getMode() const { return mode; }
+
+    // GPU memory held by the vertex and index buffers
+    size_t getBufferBytes() const { return BufferedBytes(gridSizeX, gridSizeZ, mode); }
+    // CPU generation plus upload time of the last rebuild
+    float getBuildMs() const { return buildMs; }
+    unsigned int getBakeCount() const { return bakeCount; }
+
+    static size_t BufferedBytes(int gridSizeX, int gridSizeZ, Mode mode = Mode::BUFFERED);
+
+private:
+    void build();
+    void release();
+
+private:
+    struct HonmoonVertex {
+        glm::vec2 texCoords;
+    };
+
+    // Matches HonmoonBake.comp, w of the position is 0 for skipped edge vertices
+    struct BakedVertex {
+        glm::vec4 position;
+        glm::vec4 normal;
+    };
+
+    int gridSizeX, gridSizeZ;
+    Mode mode = Mode::BUFFERED;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int emptyVAO = 0;   // core profile still needs a VAO bound to draw
+    unsigned int bakedVAO = 0;
+    size_t indexCount = 0;
+    float buildMs = 0.0f;
+
+    ComputeShader& bakeShader;
+    bool bakeValid = false;
+    glm::vec3 bakedPosition = glm::vec3(0.0f);
+    glm::vec3 bakedSize = glm::vec3(0.0f);
+    float bakedHoverHeight = 0.0f;
+    unsigned int bakedGeneration = 0;     // of the height field
+    unsigned int bakeCount = 0;
+};
@@ -0,0 +1,133 @@
+#include "HonmoonQuadtree.hpp"
+#include "../Renderer/GLState.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string>
+
+HonmoonQuadtree::HonmoonQuadtree(int patchSize)
+{
+    setPatchSize(patchSize);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &instanceVBO);
+
+    // Only per patch data, the patch vertices come from gl_VertexID
+    GLState::BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+    glEnableVertexAttribArray(1); // Patch
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Patch), (void*)0);
+    glVertexAttribDivisor(1, 1);
+
+    GLState::BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void HonmoonQuadtree::setPatchSize(int patchSize)
+{
+    this->patchSize = 2;
+    while (this->patchSize * 2 <= patchSize) this->patchSize *= 2;
+}
+
+void HonmoonQuadtree::select(const HonmoonParams& honmoon, const CameraData& camera, const HeightField& heightField, int finestResolution, float lodDistance)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    levelCount = 1;
+    while (levelCount < maxLevels && (patchSize << (levelCount - 1)) < finestResolution) levelCount++;
+
+    // A level has to reach past its own node diagonal, or it could border a level two steps away
+    float leafScale = 1.0f / float(1 << (levelCount - 1));
+    float leafDiagonal = glm::length(glm::vec2(honmoon.size.x, honmoon.size.z)) * leafScale;
+    float range = std::max(lodDistance, leafDiagonal * 2.0f);
+
+    float previous = 0.0f;
+    for (int level = 0; level < levelCount; level++) {
+        ranges[level] = range;
+        morphRanges[level] = glm::vec2(range - (range - previous) * morphRatio, range);
+
+        previous = range;
+        range *= 2.0f;
+    }
+
+    // Nothing coarser to morph into
+    ranges[levelCount - 1] = std::numeric_limits<float>::max();
+    morphRanges[levelCount - 1] = glm::vec2(1e30f, 2e30f);
+
+    Selection selection{ honmoon, heightField, camera.Position, Frustum(camera.projectionMatrix * camera.viewMatrix) };
+
+    patches.clear();
+    selectNode(selection, glm::vec2(0.0f), 1.0f, levelCount - 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Patch) * patches.size(), patches.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    selectMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool HonmoonQuadtree::selectNode(const Selection& selection, const glm::vec2& offset, float scale, int level)
+{
+    Bounds bounds = nodeBounds(selection, offset, scale);
+
+    // Handled, there is just nothing to draw
+    if (!selection.frustum.intersects(bounds)) return true;
+
+    float distance = DistanceSquared(bounds, selection.cameraPosition);
+    if (distance > ranges[level] * ranges[level]) return false;
+
+    if (level == 0 || distance > ranges[level - 1] * ranges[level - 1]) {
+        patches.push_back({ offset, scale, float(level) });
+        return true;
+    }
+
+    float half = scale * 0.5f;
+    for (int i = 0; i < 4; i++) {
+        glm::vec2 childOffset = offset + glm::vec2(i & 1, i >> 1) * half;
+
+        // Past the child's range its vertices are fully morphed, so it matches this level's grid
+        if (!selectNode(selection, childOffset, half, level - 1))
+            patches.push_back({ childOffset, half, float(level - 1) });
+    }
+
+    return true;
+}
+
+Bounds HonmoonQuadtree::nodeBounds(const Selection& selection, const glm::vec2& offset, float scale) const
+{
+    const HonmoonParams& honmoon = selection.honmoon;
+
+    // Same flip as Honmoon.vert, texture y grows towards -z
+    glm::vec2 uvMin(offset.x, 1.0f - (offset.y + scale));
+    glm::vec2 uvMax(offset.x + scale, 1.0f - offset.y);
+    glm::vec2 heights = selection.heightField.getHeightRange(uvMin, uvMax);
+
+    Bounds bounds;
+    bounds.min = honmoon.position + honmoon.size * glm::vec3(offset.x, 0.0f, offset.y);
+    bounds.max = honmoon.position + honmoon.size * glm::vec3(offset.x + scale, 0.0f, offset.y + scale);
+
+    // The hover offset follows the normal, so it can move vertices sideways too
+    bounds.min += glm::vec3(-honmoon.hoverHeight, heights.x - honmoon.hoverHeight, -honmoon.hoverHeight);
+    bounds.max += glm::vec3(honmoon.hoverHeight, heights.y + honmoon.hoverHeight, honmoon.hoverHeight);
+
+    return bounds;
+}
+
+void HonmoonQuadtree::Draw(const Shader& shader) const
+{
+    shader.setInt("gridMode", 2);
+    shader.setInt("patchSize", patchSize);
+    // Only used to skip the outer edge, like the uniform grid
+    shader.setVec2("gridSize", glm::vec2(float(getFinestResolution())));
+
+    for (int level = 0; level < levelCount; level++)
+        shader.setVec2("morphRanges[" + std::to_string(level) + "]", morphRanges[level]);
+
+    if (patches.empty()) return;
+
+    GLState::BindVertexArray(VAO);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6 * patchSize * patchSize, GLsizei(patches.size()));
+    GLState::BindVertexArray(0);
+}
@@ -0,0 +1,79 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <vector>
+// My headers
+#include "HeightField.hpp"
+#include "../Bounds.hpp"
+#include "../Shaders/Shader.hpp"
+#include "../Renderer/FramePacket.hpp"
+
+// Continuous distance dependent LOD for the Honmoon (CDLOD).
+// The Honmoon area is a quadtree whose nodes all draw the same patch of patchSize^2 cells,
+// so every level up has cells twice as large. Each level is used up to twice the distance of
+// the one below, which keeps the cell size on screen roughly constant, and vertices morph into
+// the next coarser grid before the switch so neighbouring levels meet without cracks.
+// Nodes are culled against the camera with the height range from the HeightField pyramid, which
+// reaches the CPU a frame or two late and is padded for it.
+class HonmoonQuadtree {
+public:
+    static constexpr int maxLevels = 12;
+    // Share of each level's distance band spent morphing into the next level
+    static constexpr float morphRatio = 0.34f;
+
+public:
+    explicit HonmoonQuadtree(int patchSize);
+
+    HonmoonQuadtree(const HonmoonQuadtree&) = delete;
+    HonmoonQuadtree& operator=(const HonmoonQuadtree&) = delete;
+
+    // patchSize is rounded down to a power of two, morphing needs even cell counts
+    void setPatchSize(int patchSize);
+
+    // finestResolution: cells per side of the whole Honmoon at the closest level
+    // lodDistance: how far the closest level reaches, every next level reaches twice as far
+    void select(const HonmoonParams& honmoon, const CameraData& camera, const HeightField& heightField, int finestResolution, float lodDistance);
+
+    // Expects Honmoon.vert to be bound, sets its quadtree uniforms
+    void Draw(const Shader& shader) const;
+
+    int getPatchSize() const { return patchSize; }
+    int getLevelCount() const { return levelCount; }
+    int getFinestResolution() const { return patchSize << (levelCount - 1); }
+    size_t getPatchCount() const { return patches.size(); }
+    size_t getTriangleCount() const { return patches.size() * 2 * size_t(patchSize) * patchSize; }
+    float getSelectMs() const { return selectMs; }
+
+private:
+    // Texture space like the HonmoonGrid coordinates, level 0 is the finest
+    struct Patch {
+        glm::vec2 offset;
+        float scale;
+        float level;
+    };
+
+    struct Selection {
+        const HonmoonParams& honmoon;
+        const HeightField& heightField;
+        glm::vec3 cameraPosition;
+        Frustum frustum;
+    };
+
+    // Returns false if the node is beyond its level's range, the parent then draws it at its own level
+    bool selectNode(const Selection& selection, const glm::vec2& offset, float scale, int level);
+    Bounds nodeBounds(const Selection& selection, const glm::vec2& offset, float scale) const;
+
+private:
+    int patchSize;
+    int levelCount = 1;
+    float ranges[maxLevels] = {};
+    glm::vec2 morphRanges[maxLevels] = {};
+
+    std::vector<Patch> patches;
+    unsigned int VAO = 0, instanceVBO = 0;
+
+    float selectMs = 0.0f;
+};
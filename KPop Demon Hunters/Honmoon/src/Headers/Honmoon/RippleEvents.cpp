@@ -0,0 +1,95 @@
+#include "RippleEvents.hpp"
+#include <algorithm>
+
+RippleEvents::RippleEvents(ComputeShader& binShader)
+    : events(capacity), timer(GL_TIME_ELAPSED), binShader(binShader)
+{
+    // Zero strength marks an unused slot
+    glGenBuffers(1, &eventBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, eventBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(RippleEvent), events.data(), GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &countBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tilesPerSide * tilesPerSide * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &listBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, listBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tilesPerSide * tilesPerSide * maxEventsPerTile * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void RippleEvents::push(const std::vector<RippleEvent>& newEvents)
+{
+    // More than the ring holds in one go, only the newest survive anyway
+    size_t first = newEvents.size() > capacity ? newEvents.size() - capacity : 0;
+    pushed += newEvents.size();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, eventBuffer);
+
+    size_t i = first;
+    while (i < newEvents.size()) {
+        // Contiguous run up to the end of the ring
+        size_t run = std::min(newEvents.size() - i, size_t(capacity - head));
+        std::copy(newEvents.begin() + i, newEvents.begin() + i + run, events.begin() + head);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, head * sizeof(RippleEvent), run * sizeof(RippleEvent), &newEvents[i]);
+
+        head = int((head + run) % capacity);
+        i += run;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void RippleEvents::bin(const HonmoonParams& honmoon, float time)
+{
+    if (timer.poll()) gpuMs = timer.getResult() / 1000000.0f;
+
+    timer.begin();
+
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    binShader.use();
+    binShader.setFloat("time", time);
+    binShader.setVec4("rippleParams", glm::vec4(honmoon.rippleSpeed, honmoon.rippleWavelength, honmoon.rippleLifetime, honmoon.rippleAmplitude));
+    binShader.setVec4("rippleArea", glm::vec4(honmoon.position.x, honmoon.position.z, honmoon.size.x, honmoon.size.z));
+    binShader.setInt("rippleTiles", tilesPerSide);
+    binShader.setInt("maxRipplesPerTile", maxEventsPerTile);
+    binShader.setInt("eventCount", capacity);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, eventBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, countBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, listBuffer);
+
+    glDispatchCompute((capacity + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    timer.end();
+}
+
+void RippleEvents::bind(const Shader& shader, const HonmoonParams& honmoon, float time) const
+{
+    shader.setBool("useRipples", true);
+    shader.setFloat("time", time);
+    shader.setVec4("rippleParams", glm::vec4(honmoon.rippleSpeed, honmoon.rippleWavelength, honmoon.rippleLifetime, honmoon.rippleAmplitude));
+    shader.setVec4("rippleArea", glm::vec4(honmoon.position.x, honmoon.position.z, honmoon.size.x, honmoon.size.z));
+    shader.setInt("rippleTiles", tilesPerSide);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, eventBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, countBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, listBuffer);
+}
+
+int RippleEvents::getLiveCount(float time, float lifetime) const
+{
+    int live = 0;
+    for (const RippleEvent& event : events) {
+        float age = time - event.startTime;
+        if (event.strength > 0.0f && age >= 0.0f && age <= lifetime) live++;
+    }
+    return live;
+}
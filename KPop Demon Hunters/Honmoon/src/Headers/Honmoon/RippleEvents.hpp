@@ -0,0 +1,58 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <vector>
+// My headers
+#include "../Shaders/Shader.hpp"
+#include "../Renderer/FramePacket.hpp"
+#include "../Renderer/GpuQuery.hpp"
+
+// Impact ripples on the Honmoon, kept in a fixed size ring of events on the GPU: new events overwrite
+// the oldest. Every frame RippleBin.comp bins the live events into world tiles over the Honmoon area,
+// keeping an event only in the tiles its wave front crosses, and Honmoon.vert/Honmoon.frag evaluate
+// only the events of their own tile. Per vertex and per fragment cost is capped by maxEventsPerTile,
+// so thousands of live events cost about the same as a handful.
+class RippleEvents {
+public:
+    static constexpr int capacity = 4096;
+    static constexpr int tilesPerSide = 32;
+    static constexpr int maxEventsPerTile = 64;
+
+public:
+    explicit RippleEvents(ComputeShader& binShader);
+
+    RippleEvents(const RippleEvents&) = delete;
+    RippleEvents& operator=(const RippleEvents&) = delete;
+
+    // Writes the events at the head of the ring
+    void push(const std::vector<RippleEvent>& events);
+
+    // Rebuilds the tile lists for this time
+    void bin(const HonmoonParams& honmoon, float time);
+
+    // Sets the ripple uniforms of Honmoon.vert and Honmoon.frag and binds the buffers
+    void bind(const Shader& shader, const HonmoonParams& honmoon, float time) const;
+
+    int getLiveCount(float time, float lifetime) const;
+    unsigned long long getPushedCount() const { return pushed; }
+    float getGpuMs() const { return gpuMs; }
+
+private:
+
+private:
+    unsigned int eventBuffer = 0;
+    unsigned int countBuffer = 0;
+    unsigned int listBuffer = 0;
+
+    int head = 0;
+    unsigned long long pushed = 0;
+    std::vector<RippleEvent> events;    // CPU mirror of the ring, for the live count
+
+    GpuQuery timer;     // of the clear and the binning dispatch
+    float gpuMs = 0.0f;
+
+    ComputeShader& binShader;
+};
@@ -20,17 +20,13 @@ namespace IO {
 
 using namespace IO;
 
-void inline resizeFrameBuffer() {
-}
-
 void inline framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	SCR_WIDTH = width;
 	SCR_HEIGHT = height;
 
-	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-
-	resizeFrameBuffer();
+	// Called on the main thread, the context lives on the render thread which
+	// sizes its viewport and render graph targets from the frame packet
 }
 
 void inline mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
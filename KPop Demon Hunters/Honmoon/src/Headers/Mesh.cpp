@@ -1,45 +1,78 @@
 #include "Mesh.hpp"
+#include "Renderer/GLState.hpp"
 
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
     : vertices(vertices), indices(indices), textures(textures)
 {
     setupMesh();
+    setupSamplers();
+
+    for (const Vertex& vertex : vertices)
+        bounds.expand(vertex.Position);
 }
 
 void Mesh::setupMesh() {
+    std::vector<glm::vec3> positions;
+    std::vector<VertexAttributes> attributes;
+    positions.reserve(vertices.size());
+    attributes.reserve(vertices.size());
+
+    for (const Vertex& vertex : vertices) {
+        positions.push_back(vertex.Position);
+        attributes.push_back({ vertex.Normal, vertex.TexCoords, vertex.Tangent, vertex.Bitangent });
+    }
+
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    glGenVertexArrays(1, &depthVAO);
+    glGenBuffers(1, &positionVBO);
+    glGenBuffers(1, &attributeVBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
+    glBufferData(GL_ARRAY_BUFFER, attributes.size() * sizeof(VertexAttributes), &attributes[0], GL_STATIC_DRAW);
+
+    // Full layout
+    GLState::BindVertexArray(VAO);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
     // Position
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, attributeVBO);
     // Normal
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, Normal));
     // TexCoords
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, TexCoords));
     // Tangent
     glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, Tangent));
     // Bitangent
     glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAttributes), (void*)offsetof(VertexAttributes, Bitangent));
+
+    // Depth-only layout, same index buffer
+    GLState::BindVertexArray(depthVAO);
 
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // Position
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
 
-    glBindVertexArray(0);
+    GLState::BindVertexArray(0);
 }
 
-void Mesh::Draw(Shader& shader) {
+void Mesh::setupSamplers() {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
@@ -48,8 +81,6 @@ void Mesh::Draw(Shader& shader) {
     unsigned int aoNr = 1;
 
     for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-
         std::string number;
         std::string name = textures[i].type;
 
@@ -60,13 +91,38 @@ void Mesh::Draw(Shader& shader) {
         else if (name == "texture_metallic")  number = std::to_string(metallicNr++);
         else if (name == "texture_ao")        number = std::to_string(aoNr++);
 
-        shader.setInt("material." + (name + number), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        samplerNames.push_back("material." + (name + number));
+    }
+}
+
+void Mesh::Draw(Shader& shader) {
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        GLState::ActiveTexture(GL_TEXTURE0 + i);
+
+        shader.setInt(samplerNames[i], i);
+        GLState::BindTexture(GL_TEXTURE_2D, textures[i].id);
+    }
+
+    GLState::BindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+}
+
+void Mesh::Record(CommandBuffer& buffer, const UniformCache& uniforms) const {
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        buffer.setInt(uniforms.get(samplerNames[i]), i);
+        buffer.bindTexture(i, textures[i].id);
     }
 
-    glBindVertexArray(VAO);
+    buffer.bindVertexArray(VAO);
+    buffer.drawIndexed(static_cast<unsigned int>(indices.size()));
+}
+
+void Mesh::DrawDepth() const {
+    GLState::BindVertexArray(depthVAO);
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+}
 
-    glActiveTexture(GL_TEXTURE0);
+void Mesh::RecordDepth(CommandBuffer& buffer) const {
+    buffer.bindVertexArray(depthVAO);
+    buffer.drawIndexed(static_cast<unsigned int>(indices.size()));
 }
@@ -5,6 +5,8 @@
 #include <vector>
 #include "Shaders/Shader.hpp"
 #include "Textures/Textures.hpp"
+#include "Renderer/CommandBuffer.hpp"
+#include "Bounds.hpp"
 
 
 struct Vertex {
@@ -15,6 +17,15 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// Everything but the position, uploaded as a second stream so
+// depth-only passes only fetch the 12-byte positions
+struct VertexAttributes {
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
 class Mesh {
 public:
     std::vector<Vertex> vertices;
@@ -22,9 +33,22 @@ public:
     std::vector<Texture> textures;
 
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+    // Leaves the vertex array and textures bound, so a run of draws only rebinds what changes
     void Draw(Shader& shader);
+    void Record(CommandBuffer& buffer, const UniformCache& uniforms) const;
+
+    // Positions only, no textures or material uniforms
+    void DrawDepth() const;
+    void RecordDepth(CommandBuffer& buffer) const;
+
+    // "material.texture_diffuse1"... one per texture, in binding order
+    const std::vector<std::string>& getSamplerNames() const { return samplerNames; }
+    const Bounds& getBounds() const { return bounds; }
 
 private:
-    unsigned int VAO, VBO, EBO;
+    unsigned int VAO, depthVAO, positionVBO, attributeVBO, EBO;
+    std::vector<std::string> samplerNames;
+    Bounds bounds;
     void setupMesh();
+    void setupSamplers();
 };
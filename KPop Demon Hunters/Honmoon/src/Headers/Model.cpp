@@ -1,9 +1,20 @@
 #include "Model.hpp"
+#include "Renderer/GLState.hpp"
 #include <iostream>
 
 void Model::Draw(Shader& shader) {
     for (unsigned int i = 0; i < meshes.size(); i++)
         meshes[i].Draw(shader);
+
+    GLState::BindVertexArray(0);
+    GLState::ActiveTexture(GL_TEXTURE0);
+}
+
+Bounds Model::getBounds() const {
+    Bounds bounds;
+    for (const Mesh& mesh : meshes)
+        bounds.expand(mesh.getBounds());
+    return bounds;
 }
 
 void Model::loadModel(const std::string& path) {
@@ -17,6 +17,12 @@ public:
     Model(const std::string& path) { loadModel(path); }
     void Draw(Shader& shader);
 
+    const std::vector<Mesh>& getMeshes() const { return meshes; }
+    std::vector<Mesh>& getMeshes() { return meshes; }
+
+    // Union of the mesh bounds, in model space
+    Bounds getBounds() const;
+
 private:
     std::vector<Mesh> meshes;
     std::string directory;
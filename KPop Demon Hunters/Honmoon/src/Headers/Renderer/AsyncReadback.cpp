@@ -0,0 +1,162 @@
+#include "AsyncReadback.hpp"
+#include "GLState.hpp"
+#include <iostream>
+
+AsyncReadback::AsyncReadback(int slotCount)
+    : slots(slotCount)
+{
+    for (Slot& slot : slots)
+        glGenBuffers(1, &slot.PBO);
+}
+
+size_t AsyncReadback::BytesPerPixel(GLenum format, GLenum type)
+{
+    size_t components = 0;
+    switch (format) {
+    case GL_RED: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX: case GL_RED_INTEGER: components = 1; break;
+    case GL_RG: case GL_RG_INTEGER: components = 2; break;
+    case GL_RGB: case GL_BGR: components = 3; break;
+    case GL_RGBA: case GL_BGRA: components = 4; break;
+    default: break;
+    }
+
+    switch (type) {
+    case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+    case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+    case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return components * 4;
+    default: return 0;
+    }
+}
+
+AsyncReadback::Slot* AsyncReadback::acquire(size_t bytes)
+{
+    if (bytes == 0) {
+        std::cerr << "AsyncReadback: unsupported format" << std::endl;
+        return nullptr;
+    }
+
+    if (inFlight.size() >= slots.size()) {
+        dropped++;
+        return nullptr;
+    }
+
+    for (int i = 0; i < int(slots.size()); i++) {
+        Slot& slot = slots[i];
+        if (slot.fence != nullptr) continue;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+        if (slot.capacity < bytes) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            slot.capacity = bytes;
+        }
+
+        inFlight.push_back(i);
+        return &slot;
+    }
+
+    dropped++;
+    return nullptr;
+}
+
+void AsyncReadback::submit(Slot& slot, unsigned long long tag, int width, int height, size_t bytes)
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.tag = tag;
+    slot.frame = currentFrame;
+    slot.width = width;
+    slot.height = height;
+    slot.bytes = bytes;
+    slot.issued = clock::now();
+
+    requested++;
+}
+
+bool AsyncReadback::readFramebuffer(unsigned int framebuffer, GLenum readBuffer, int x, int y, int width, int height, GLenum format, GLenum type, unsigned long long tag)
+{
+    size_t bytes = size_t(width) * height * BytesPerPixel(format, type);
+    Slot* slot = acquire(bytes);
+    if (slot == nullptr) return false;
+
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(readBuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    // With a pack buffer bound the pointer is an offset, the copy is queued instead of waited on
+    glReadPixels(x, y, width, height, format, type, nullptr);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+
+    submit(*slot, tag, width, height, bytes);
+    return true;
+}
+
+bool AsyncReadback::readTexture(unsigned int texture, int level, int width, int height, GLenum format, GLenum type, unsigned long long tag)
+{
+    size_t bytes = size_t(width) * height * BytesPerPixel(format, type);
+    Slot* slot = acquire(bytes);
+    if (slot == nullptr) return false;
+
+    GLState::BindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    glGetTexImage(GL_TEXTURE_2D, level, format, type, nullptr);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+    submit(*slot, tag, width, height, bytes);
+    return true;
+}
+
+void AsyncReadback::poll(unsigned int frame, const Callback& callback)
+{
+    currentFrame = frame;
+
+    while (!inFlight.empty()) {
+        Slot& slot = slots[inFlight.front()];
+
+        // Zero timeout: only asks, the flush makes sure the fence gets to the GPU at all
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        inFlight.pop_front();
+
+        Result result;
+        result.tag = slot.tag;
+        result.frame = slot.frame;
+        result.width = slot.width;
+        result.height = slot.height;
+        result.bytes = slot.bytes;
+        result.latencyFrames = frame - slot.frame;
+        result.latencyMs = std::chrono::duration<float, std::milli>(clock::now() - slot.issued).count();
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+        result.data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+        if (result.data != nullptr) {
+            callback(result);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        completed++;
+        lastLatencyFrames = result.latencyFrames;
+        lastLatencyMs = result.latencyMs;
+        averageLatencyMs = completed == 1 ? result.latencyMs : averageLatencyMs * 0.9f + result.latencyMs * 0.1f;
+        windowBytes += slot.bytes;
+    }
+
+    float elapsed = std::chrono::duration<float>(clock::now() - windowStart).count();
+    if (elapsed >= 1.0f) {
+        throughputMBs = windowBytes / (1024.0f * 1024.0f) / elapsed;
+        windowBytes = 0;
+        windowStart = clock::now();
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// Other
+#include <deque>
+#include <chrono>
+#include <vector>
+#include <functional>
+
+// Copies of GPU images that reach the CPU a few frames later without stalling the pipeline.
+// Each request copies into its own pixel pack buffer of a fixed ring and drops a fence behind it.
+// poll() only maps buffers whose fence already signalled, and a request finding the ring full is
+// dropped rather than waiting, so callers that must not lose data retry on a later frame.
+// Works on any framebuffer attachment or texture level.
+class AsyncReadback {
+public:
+    struct Result {
+        unsigned long long tag;     // whatever the caller passed with the request
+        unsigned int frame;         // frame the request was made on
+        int width, height;
+        const void* data;           // only valid inside the callback
+        size_t bytes;
+
+        unsigned int latencyFrames;
+        float latencyMs;
+    };
+
+    using Callback = std::function<void(const Result& result)>;
+
+public:
+    explicit AsyncReadback(int slotCount = 3);
+
+    AsyncReadback(const AsyncReadback&) = delete;
+    AsyncReadback& operator=(const AsyncReadback&) = delete;
+
+    // readBuffer is GL_NONE for depth and stencil. Returns false if the ring is full.
+    bool readFramebuffer(unsigned int framebuffer, GLenum readBuffer, int x, int y, int width, int height, GLenum format, GLenum type, unsigned long long tag = 0);
+    bool readTexture(unsigned int texture, int level, int width, int height, GLenum format, GLenum type, unsigned long long tag = 0);
+
+    // Call once per frame before any request. Hands every finished copy to the callback, oldest first, never waits.
+    void poll(unsigned int frame, const Callback& callback);
+
+    int getSlotCount() const { return int(slots.size()); }
+    int getInFlight() const { return int(inFlight.size()); }
+
+    unsigned long long getRequested() const { return requested; }
+    unsigned long long getCompleted() const { return completed; }
+    unsigned long long getDropped() const { return dropped; }
+
+    unsigned int getLastLatencyFrames() const { return lastLatencyFrames; }
+    float getLastLatencyMs() const { return lastLatencyMs; }
+    float getAverageLatencyMs() const { return averageLatencyMs; }
+    // Delivered bytes per second, over roughly the last second
+    float getThroughputMBs() const { return throughputMBs; }
+
+    static size_t BytesPerPixel(GLenum format, GLenum type);
+
+private:
+    using clock = std::chrono::high_resolution_clock;
+
+    struct Slot {
+        unsigned int PBO = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+
+        unsigned long long tag = 0;
+        unsigned int frame = 0;
+        int width = 0, height = 0;
+        size_t bytes = 0;
+        clock::time_point issued;
+    };
+
+    // Next free slot with room for bytes, nullptr if every slot is in flight
+    Slot* acquire(size_t bytes);
+    void submit(Slot& slot, unsigned long long tag, int width, int height, size_t bytes);
+
+private:
+    std::vector<Slot> slots;
+    std::deque<int> inFlight;       // request order, fences signal in the same order
+    unsigned int currentFrame = 0;
+
+    unsigned long long requested = 0;
+    unsigned long long completed = 0;
+    unsigned long long dropped = 0;
+
+    unsigned int lastLatencyFrames = 0;
+    float lastLatencyMs = 0.0f;
+    float averageLatencyMs = 0.0f;
+
+    clock::time_point windowStart = clock::now();
+    size_t windowBytes = 0;
+    float throughputMBs = 0.0f;
+};
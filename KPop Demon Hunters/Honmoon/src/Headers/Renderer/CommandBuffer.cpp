@@ -0,0 +1,110 @@
+#include "CommandBuffer.hpp"
+#include "GLState.hpp"
+#include <glad/glad.h>
+
+void CommandBuffer::bindProgram(unsigned int program)
+{
+    commands.push_back({ CommandType::BIND_PROGRAM, 0, program });
+}
+
+void CommandBuffer::bindVertexArray(unsigned int vertexArray)
+{
+    commands.push_back({ CommandType::BIND_VERTEX_ARRAY, 0, vertexArray });
+}
+
+void CommandBuffer::bindTexture(unsigned int unit, unsigned int texture)
+{
+    commands.push_back({ CommandType::BIND_TEXTURE, static_cast<int32_t>(unit), texture });
+}
+
+void CommandBuffer::setInt(int location, int value)
+{
+    if (location < 0) return;
+    commands.push_back({ CommandType::SET_INT, location, static_cast<uint32_t>(value) });
+}
+
+void CommandBuffer::setMat4(int location, const glm::mat4& value)
+{
+    if (location < 0) return;
+    commands.push_back({ CommandType::SET_MAT4, location, static_cast<uint32_t>(matrices.size()) });
+    matrices.push_back(value);
+}
+
+void CommandBuffer::drawIndexed(unsigned int indexCount)
+{
+    commands.push_back({ CommandType::DRAW_INDEXED, 0, indexCount });
+}
+
+void CommandBuffer::clear()
+{
+    commands.clear();
+    matrices.clear();
+}
+
+void UniformCache::resolve(unsigned int program, const std::string& name)
+{
+    locations[name] = glGetUniformLocation(program, name.c_str());
+}
+
+int UniformCache::get(const std::string& name) const
+{
+    auto it = locations.find(name);
+    return it == locations.end() ? -1 : it->second;
+}
+
+void ReplayCommandBuffer(const CommandBuffer& buffer)
+{
+    for (const Command& command : buffer.getCommands()) {
+        switch (command.type) {
+        case CommandType::BIND_PROGRAM:
+            GLState::UseProgram(command.value);
+            break;
+        case CommandType::BIND_VERTEX_ARRAY:
+            GLState::BindVertexArray(command.value);
+            break;
+        case CommandType::BIND_TEXTURE:
+            GLState::ActiveTexture(GL_TEXTURE0 + command.handle);
+            GLState::BindTexture(GL_TEXTURE_2D, command.value);
+            break;
+        case CommandType::SET_INT:
+            glUniform1i(command.handle, static_cast<int>(command.value));
+            break;
+        case CommandType::SET_MAT4:
+            glUniformMatrix4fv(command.handle, 1, GL_FALSE, &buffer.getMatrix(command.value)[0][0]);
+            break;
+        case CommandType::DRAW_INDEXED:
+            glDrawElements(GL_TRIANGLES, command.value, GL_UNSIGNED_INT, 0);
+            break;
+        }
+    }
+
+    GLState::BindVertexArray(0);
+    GLState::ActiveTexture(GL_TEXTURE0);
+}
+
+void ReplayCommandBuffer(const CommandBuffer& buffer, ReplayState& state)
+{
+    for (const Command& command : buffer.getCommands()) {
+        switch (command.type) {
+        case CommandType::BIND_PROGRAM:
+            (GLState::UseProgram(command.value) ? state.issued : state.skipped)++;
+            break;
+        case CommandType::BIND_VERTEX_ARRAY:
+            (GLState::BindVertexArray(command.value) ? state.issued : state.skipped)++;
+            break;
+        case CommandType::BIND_TEXTURE:
+            GLState::ActiveTexture(GL_TEXTURE0 + command.handle);
+            (GLState::BindTexture(GL_TEXTURE_2D, command.value) ? state.issued : state.skipped)++;
+            break;
+        case CommandType::SET_INT:
+            glUniform1i(command.handle, static_cast<int>(command.value));
+            break;
+        case CommandType::SET_MAT4:
+            glUniformMatrix4fv(command.handle, 1, GL_FALSE, &buffer.getMatrix(command.value)[0][0]);
+            break;
+        case CommandType::DRAW_INDEXED:
+            glDrawElements(GL_TRIANGLES, command.value, GL_UNSIGNED_INT, 0);
+            break;
+        }
+    }
+}
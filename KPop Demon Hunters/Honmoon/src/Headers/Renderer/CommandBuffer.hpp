@@ -0,0 +1,71 @@
+#pragma once
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+// Backend-agnostic list of draw commands. Recording never touches the graphics API,
+// so any thread can fill a buffer. Only the thread owning the context replays it.
+
+enum class CommandType : uint8_t {
+    BIND_PROGRAM,
+    BIND_VERTEX_ARRAY,
+    BIND_TEXTURE,
+    SET_INT,
+    SET_MAT4,
+    DRAW_INDEXED
+};
+
+struct Command {
+    CommandType type;
+    int32_t handle;     // uniform location or texture unit
+    uint32_t value;     // program, vertex array, texture, int value, index count or matrix slot
+};
+
+class CommandBuffer {
+public:
+    void bindProgram(unsigned int program);
+    void bindVertexArray(unsigned int vertexArray);
+    void bindTexture(unsigned int unit, unsigned int texture);
+    void setInt(int location, int value);
+    void setMat4(int location, const glm::mat4& value);
+    void drawIndexed(unsigned int indexCount);
+
+    void clear();
+
+    size_t size() const { return commands.size(); }
+    const std::vector<Command>& getCommands() const { return commands; }
+    const glm::mat4& getMatrix(uint32_t slot) const { return matrices[slot]; }
+
+private:
+    std::vector<Command> commands;
+    std::vector<glm::mat4> matrices;
+};
+
+// Uniform locations of one program, looked up on the context thread before recording
+// so workers can turn names into handles without calling into the driver.
+class UniformCache {
+public:
+    void resolve(unsigned int program, const std::string& name);
+
+    // -1 if the name was never resolved or is not an active uniform
+    int get(const std::string& name) const;
+
+private:
+    std::unordered_map<std::string, int> locations;
+};
+
+// Bind counts over a sequence of replays. The binds go through GLState, which drops the
+// ones that match what is already bound while its filtering is on.
+struct ReplayState {
+    unsigned int issued = 0;    // program, vertex array and texture binds sent
+    unsigned int skipped = 0;   // the same, dropped as redundant
+};
+
+// Issues the recorded commands, must run on the thread that owns the GL context
+void ReplayCommandBuffer(const CommandBuffer& buffer);
+// Same, counting the bindings. Leaves them bound, unlike the plain replay.
+void ReplayCommandBuffer(const CommandBuffer& buffer, ReplayState& state);
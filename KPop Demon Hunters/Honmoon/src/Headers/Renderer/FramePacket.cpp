@@ -0,0 +1,37 @@
+#include "FramePacket.hpp"
+
+ImGuiFrame::~ImGuiFrame()
+{
+    for (ImDrawList* list : lists)
+        IM_DELETE(list);
+}
+
+void ImGuiFrame::copy(const ImDrawData* src)
+{
+    data.Clear();
+    if (src == nullptr) return;
+
+    // Lists are kept between frames so their buffers only grow
+    while (lists.size() < (size_t)src->CmdListsCount)
+        lists.push_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+
+    for (int i = 0; i < src->CmdListsCount; i++) {
+        const ImDrawList* from = src->CmdLists[i];
+        ImDrawList* to = lists[i];
+
+        to->CmdBuffer = from->CmdBuffer;
+        to->IdxBuffer = from->IdxBuffer;
+        to->VtxBuffer = from->VtxBuffer;
+        to->Flags = from->Flags;
+
+        data.CmdLists.push_back(to);
+    }
+
+    data.Valid = src->Valid;
+    data.CmdListsCount = src->CmdListsCount;
+    data.TotalIdxCount = src->TotalIdxCount;
+    data.TotalVtxCount = src->TotalVtxCount;
+    data.DisplayPos = src->DisplayPos;
+    data.DisplaySize = src->DisplaySize;
+    data.FramebufferScale = src->FramebufferScale;
+}
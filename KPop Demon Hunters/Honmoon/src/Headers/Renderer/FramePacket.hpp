@@ -0,0 +1,317 @@
+#pragma once
+// GLM
+#include <glm/glm.hpp>
+// Imgui
+#include "../imgui/imgui.h"
+// Other
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+// My headers
+#include "../Bounds.hpp"
+
+// Everything the render thread needs to draw one frame.
+// The main thread fills a packet, submits it and never touches it again until
+// the render thread hands it back, so nothing in here may point at main thread state.
+
+struct CameraData {
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+    glm::mat4 projectionMatrix = glm::mat4(1.0f);
+    glm::vec3 Position = glm::vec3(0.0f);
+};
+
+struct LightData {
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    float ambient = 0.0f;
+    float diffuse = 0.0f;
+    float specular = 0.0f;
+};
+
+struct HonmoonParams {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 size = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec2 patternOrigin = glm::vec2(0.0f);
+
+    float hoverHeight = 0.0f;
+    float thickness = 1.0f;
+    float spacing = 1.0f;
+    float progress = 0.0f;
+
+    glm::vec4 color1 = glm::vec4(1.0f);
+    glm::vec4 color2 = glm::vec4(1.0f);
+
+    // Independent: texels of the height map and cells of the displaced grid, per side
+    int heightMapResolution = 100;
+    int gridResolution = 100;
+
+    // Height clipmap around the camera, see HeightClipmap
+    float clipmapTexelSize = 0.05f;
+    int clipmapTileBudget = 32;
+
+    // Quadtree LOD, see HonmoonQuadtree
+    int patchSize = 16;
+    float lodDistance = 10.0f;
+
+    // Cells per side of the grid every barrier is drawn with, see HonmoonBarriers
+    int barrierGridResolution = 32;
+
+    // Impact ripples, see RippleEvents
+    float rippleSpeed = 4.0f;
+    float rippleWavelength = 0.5f;
+    float rippleLifetime = 3.0f;
+    float rippleAmplitude = 0.15f;
+};
+
+// One impact on the Honmoon surface, laid out as the vec4 RippleEvents keeps on the GPU
+struct RippleEvent {
+    glm::vec2 origin = glm::vec2(0.0f);     // world x, z
+    float startTime = 0.0f;                 // FramePacket::time of the impact
+    float strength = 0.0f;                  // 0 is an empty slot
+};
+
+// Lantern or glow source, laid out as the two vec4 LightClusters keeps on the GPU
+struct PointLight {
+    glm::vec3 position = glm::vec3(0.0f);   // world
+    float radius = 1.0f;                    // no light at all past it
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+};
+
+using PointLightList = std::vector<PointLight>;
+
+// One more Honmoon inside the covered area, with its own placement and look.
+// It reads the part of the shared height field under it, so it must lie within HonmoonParams.
+struct HonmoonBarrier {
+    glm::vec3 position = glm::vec3(0.0f);   // corner, like HonmoonParams::position
+    glm::vec3 size = glm::vec3(1.0f);
+    glm::vec2 patternOrigin = glm::vec2(0.0f);
+
+    float hoverHeight = 0.0f;
+    float thickness = 1.0f;
+    float spacing = 1.0f;
+    float progress = 1.0f;
+
+    glm::vec4 color1 = glm::vec4(1.0f);
+    glm::vec4 color2 = glm::vec4(1.0f);
+};
+
+using BarrierList = std::vector<HonmoonBarrier>;
+
+// One mesh of one model instance
+struct DrawItem {
+    size_t modelIndex;
+    size_t meshIndex;
+    glm::mat4 modelMatrix;
+    Bounds worldBounds;
+};
+
+using DrawList = std::vector<DrawItem>;
+
+// Deep copy of the ImGui draw data. The lists owned by the ImGui context are
+// rebuilt by the next ImGui::NewFrame(), which happens while this frame renders.
+class ImGuiFrame {
+public:
+    ImGuiFrame() = default;
+    ImGuiFrame(const ImGuiFrame&) = delete;
+    ImGuiFrame& operator=(const ImGuiFrame&) = delete;
+    ~ImGuiFrame();
+
+    void copy(const ImDrawData* src);
+
+    // The OpenGL backend takes a non-const pointer but only reads from it
+    ImDrawData* drawData() const { return const_cast<ImDrawData*>(&data); }
+
+private:
+    ImDrawData data;
+    std::vector<ImDrawList*> lists;
+};
+
+struct RenderSettings {
+    bool useCommandBuffers = true;
+    bool cacheHeightMap = true;
+    bool deferredShading = true;    // scene through the G-buffer, see GBuffer
+    bool clusteredLights = true;    // point lights, see LightClusters
+    bool showLightDensity = false;  // tints the scene by the light count of each cluster
+    bool depthPrepass = false;      // positions first, then shading with GL_EQUAL
+    bool sortFrontToBack = true;    // draw list by distance to the camera, on the main thread, without the render queue only
+    bool useRenderQueue = true;     // scene sorted by state then depth, see RenderQueue
+    bool filterGLState = true;      // state changes matching the current state are dropped, see GLState
+    bool useClipmap = false;
+    bool useGeodesic = true;        // rings follow the surface, see GeodesicField
+    bool useRipples = true;
+    int honmoonResolution = 0;      // 0 full, 1 half, 2 quarter, see LowResPass
+    bool weightedBlendedOIT = false; // overlapping Honmoon layers need no sorting, see WeightedOIT
+    bool adaptiveGrid = true;
+    int gridMode = 1;               // HonmoonGrid::Mode, when not adaptive
+    bool readbackHeightMap = false; // copy every new height map back to the CPU, see HeightMapSnapshot
+    bool runSubmissionBenchmark = false;
+    bool runGridBenchmark = false;
+    bool runCpuBakeBenchmark = false;
+};
+
+struct FramePacket {
+    unsigned int frameIndex = 0;
+    float time = 0.0f;
+    float dt = 0.0f;
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    CameraData camera;
+    LightData light;
+    HonmoonParams honmoon;
+    DrawList drawList;
+    std::vector<Bounds> dirtyBounds;        // old and new world bounds of models moved this frame
+    // Never modified once shared, so a new list is only copied to the GPU when the pointer changes
+    std::shared_ptr<const BarrierList> barriers;
+    std::vector<RippleEvent> ripples;       // impacts since the last frame
+    std::shared_ptr<const PointLightList> pointLights;     // uploaded when the pointer changes, like barriers
+    RenderSettings settings;
+
+    ImGuiFrame gui;
+};
+
+// CPU time to submit the same meshes directly and through command buffers
+struct SubmissionTiming {
+    unsigned int meshCount = 0;
+    float directMs = 0.0f;
+    float recordMs = 0.0f;
+    float replayMs = 0.0f;
+};
+
+// Cost of the buffered Honmoon grid at one size, the procedural grid pays none of it
+struct GridUploadTiming {
+    int gridSize = 0;
+    size_t bytes = 0;
+    float buildMs = 0.0f;   // generation + upload until glFinish returns
+};
+
+// CPU height bake, compared against the GPU depth pass at the same resolution
+struct CpuBakeTiming {
+    int width = 0, height = 0;
+    size_t triangles = 0;
+    int tiles = 0;
+    unsigned int threads = 0;
+    float transformMs = 0.0f;
+    float binMs = 0.0f;
+    float rasterMs = 0.0f;
+    float trianglesPerSecond = 0.0f;
+    float tilesPerSecond = 0.0f;
+
+    float maxError = 0.0f;          // world units
+    float meanError = 0.0f;
+    float mismatchPercent = 0.0f;   // texels further than the tolerance from the GPU
+};
+
+// Copy of the GPU height map that reached the CPU through the asynchronous readback,
+// with the Honmoon placement it was drawn for. Normalized depth, row 0 is the bottom row.
+struct HeightMapSnapshot {
+    unsigned int frameIndex = 0;        // frame the height map was drawn on
+    int width = 0, height = 0;
+    HonmoonParams honmoon;
+    std::vector<float> depth;
+};
+
+// Written by the render thread after each frame, read back by the GUI
+struct RenderStats {
+    unsigned int frameIndex = 0;
+    float renderMs = 0.0f;
+
+    bool heightMapRegenerated = false;
+    unsigned int heightMapRegenerations = 0;
+    int heightMapTiles = 0;
+    int heightMapTilesUpdated = 0;
+    float heightMapCpuMs = 0.0f;
+    float heightMapGpuMs = 0.0f;
+
+    int clipmapTilesRendered = 0;
+    int clipmapTilesLoaded = 0;
+    int clipmapTilesPending = 0;
+    size_t clipmapCachedTiles = 0;
+    size_t clipmapCacheBytes = 0;
+
+    unsigned long long readbackRequested = 0;
+    unsigned long long readbackCompleted = 0;
+    unsigned long long readbackDropped = 0;
+    int readbackInFlight = 0;
+    unsigned int readbackLatencyFrames = 0;
+    float readbackLatencyMs = 0.0f;
+    float readbackThroughputMBs = 0.0f;     // height map and clipmap tiles together
+    unsigned long long clipmapTilesUncached = 0;
+
+    bool geodesicBuilt = false;
+    unsigned int geodesicBuilds = 0;
+    int geodesicPasses = 0;
+    float geodesicGpuMs = 0.0f;
+
+    size_t barrierCount = 0;
+    bool barriersUploaded = false;
+    unsigned int barrierUploads = 0;
+    float barrierUploadMs = 0.0f;
+    float barrierSubmitMs = 0.0f;       // CPU time of the barrier draw, upload excluded
+
+    int rippleLive = 0;
+    unsigned long long ripplesPushed = 0;
+    float rippleBinGpuMs = 0.0f;
+
+    size_t gBufferBytes = 0;            // 0 when shading forward
+
+    int renderGraphPasses = 0;
+    int renderGraphCulled = 0;
+    std::string renderGraphOrder;
+    int renderGraphTargets = 0;         // transient textures declared and used
+    int renderGraphTextures = 0;        // pooled textures backing them
+    size_t renderGraphBytes = 0;
+    size_t renderGraphUnaliasedBytes = 0;   // the same targets without sharing textures
+    unsigned int renderGraphAllocations = 0;
+    float renderGraphCompileMs = 0.0f;
+
+    bool useRenderQueue = false;
+    size_t renderQueueItems = 0;
+    int renderQueueSortPasses = 0;
+    float renderQueueMs = 0.0f;         // keys, radix sort and reordering
+    // Program, vertex array and texture binds replayed per frame, without and with the render queue
+    std::array<unsigned int, 2> bindsIssued = { 0, 0 };
+    std::array<unsigned int, 2> bindsSkipped = { 0, 0 };
+
+    // State calls through GLState per frame, GUI excluded
+    unsigned int glCallsIssued = 0;
+    unsigned int glCallsFiltered = 0;
+
+    bool depthPrepass = false;
+    bool pipelineStatistics = false;    // fragment counts below are only valid if supported
+    std::array<unsigned long long, 2> sceneFragments = { 0, 0 };    // shading pass fragment shader invocations, without and with the pre-pass
+    std::array<float, 2> sceneGpuMs = { 0.0f, 0.0f };               // whole scene, pre-pass included
+
+    size_t pointLights = 0;
+    size_t lightIndices = 0;            // light references over all clusters
+    int lightClustersOccupied = 0;
+    int maxLightsPerCluster = 0;
+    unsigned int lightUploads = 0;
+    float lightAssignMs = 0.0f;         // CPU, on the workers
+
+    int honmoonResolution = 0;
+    std::array<float, 3> honmoonGpuMs = { 0.0f, 0.0f, 0.0f };   // last Honmoon pass measured at full, half and quarter resolution
+
+    int quadtreeLevels = 0;
+    size_t quadtreePatches = 0;
+    size_t quadtreeTriangles = 0;
+    float quadtreeSelectMs = 0.0f;
+
+    size_t gridBufferBytes = 0;
+    bool gridBaked = false;
+    unsigned int gridBakes = 0;
+    float gridBuildMs = 0.0f;
+
+    unsigned int recordThreads = 0;
+    bool hasSubmissionBenchmark = false;
+    std::array<SubmissionTiming, 3> submissionBenchmark;
+
+    bool hasGridBenchmark = false;
+    std::array<GridUploadTiming, 4> gridBenchmark;
+
+    bool hasCpuBake = false;
+    CpuBakeTiming cpuBake;
+};
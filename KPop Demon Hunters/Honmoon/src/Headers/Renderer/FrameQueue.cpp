@@ -0,0 +1,74 @@
+#include "FrameQueue.hpp"
+
+FramePacket* FrameQueue::beginWrite()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return closed || states[writeIndex] == SlotState::FREE; });
+
+    if (closed) return nullptr;
+    return &packets[writeIndex];
+}
+
+void FrameQueue::endWrite()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states[writeIndex] = SlotState::READY;
+        writeIndex ^= 1;
+    }
+    condition.notify_all();
+}
+
+const FramePacket* FrameQueue::beginRead()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return closed || states[readIndex] == SlotState::READY; });
+
+    if (states[readIndex] != SlotState::READY) return nullptr;
+
+    states[readIndex] = SlotState::RENDERING;
+    return &packets[readIndex];
+}
+
+void FrameQueue::endRead()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states[readIndex] = SlotState::FREE;
+        readIndex ^= 1;
+    }
+    condition.notify_all();
+}
+
+void FrameQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    condition.notify_all();
+}
+
+void FrameQueue::publishStats(const RenderStats& stats)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->stats = stats;
+}
+
+RenderStats FrameQueue::latestStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void FrameQueue::publishHeightMap(std::shared_ptr<const HeightMapSnapshot> snapshot)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    heightMap = std::move(snapshot);
+}
+
+std::shared_ptr<const HeightMapSnapshot> FrameQueue::latestHeightMap()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return heightMap;
+}
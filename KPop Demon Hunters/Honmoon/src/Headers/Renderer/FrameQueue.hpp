@@ -0,0 +1,49 @@
+#pragma once
+// Other
+#include <array>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+// My headers
+#include "FramePacket.hpp"
+
+// Two frame packets handed back and forth between the main thread and the render thread.
+// While the render thread draws frame N from one slot, the main thread fills frame N+1 in the other.
+class FrameQueue {
+public:
+    // Main thread: waits for a free slot, returns nullptr once the queue is closed
+    FramePacket* beginWrite();
+    void endWrite();
+
+    // Render thread: waits for a submitted slot, returns nullptr once the queue is closed and drained
+    const FramePacket* beginRead();
+    void endRead();
+
+    void close();
+
+    void publishStats(const RenderStats& stats);
+    RenderStats latestStats();
+
+    // Render thread hands over each height map readback, the main thread keeps a reference as long as it needs
+    void publishHeightMap(std::shared_ptr<const HeightMapSnapshot> snapshot);
+    std::shared_ptr<const HeightMapSnapshot> latestHeightMap();
+
+private:
+    enum class SlotState {
+        FREE,
+        READY,
+        RENDERING
+    };
+
+    std::array<FramePacket, 2> packets;
+    std::array<SlotState, 2> states = { SlotState::FREE, SlotState::FREE };
+    int writeIndex = 0;
+    int readIndex = 0;
+    bool closed = false;
+
+    RenderStats stats;
+    std::shared_ptr<const HeightMapSnapshot> heightMap;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+};
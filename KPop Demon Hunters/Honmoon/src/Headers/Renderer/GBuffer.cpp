@@ -0,0 +1,50 @@
+#include "GBuffer.hpp"
+#include "GLState.hpp"
+
+GBuffer::GBuffer(Shader& lightingShader, unsigned int quadVAO)
+    : lightingShader(lightingShader), quadVAO(quadVAO)
+{
+}
+
+void GBuffer::beginGeometry()
+{
+    // Opaque only, the albedo alpha is material data and must not blend
+    GLState::Disable(GL_BLEND);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::light(const Targets& targets, const CameraData& camera, const LightData& light)
+{
+    // Every pixel once, depth copied through gl_FragDepth whatever the target's depth format
+    GLState::DepthFunc(GL_ALWAYS);
+
+    lightingShader.use();
+    lightingShader.setInt("gAlbedo", 0);
+    lightingShader.setInt("gNormal", 1);
+    lightingShader.setInt("gDepth", 2);
+
+    lightingShader.setMat4("inverseViewProjection", glm::inverse(camera.projectionMatrix * camera.viewMatrix));
+    lightingShader.setMat4("view", camera.viewMatrix);
+    lightingShader.setVec3("viewPos", camera.Position);
+
+    lightingShader.setVec3("dirLight.direction", light.direction);
+    lightingShader.setVec3("dirLight.ambient", glm::vec3(light.ambient));
+    lightingShader.setVec3("dirLight.diffuse", glm::vec3(light.diffuse));
+    lightingShader.setVec3("dirLight.specular", glm::vec3(light.specular));
+    lightingShader.setVec3("dirLight.color", glm::vec3(1.0f));
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, targets.albedo);
+    GLState::ActiveTexture(GL_TEXTURE1);
+    GLState::BindTexture(GL_TEXTURE_2D, targets.normal);
+    GLState::ActiveTexture(GL_TEXTURE2);
+    GLState::BindTexture(GL_TEXTURE_2D, targets.depth);
+
+    GLState::BindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    GLState::BindVertexArray(0);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::DepthFunc(GL_LESS);
+    GLState::Enable(GL_BLEND);
+}
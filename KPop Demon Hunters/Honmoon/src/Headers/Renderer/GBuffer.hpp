@@ -0,0 +1,50 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// My headers
+#include "FramePacket.hpp"
+#include "../Shaders/Shader.hpp"
+
+// Compact G-buffer for deferred shading of the scene, 12 bytes per pixel:
+// albedo RGBA8 with roughness and specular packed 4 bits each in alpha, an octahedral
+// world normal in RG16 and a 32-bit depth the lighting pass reconstructs positions from.
+// GBuffer.frag writes it, DeferredLighting.frag lights every pixel once in a fullscreen pass.
+// Nothing here is allocated: the three targets are render graph transients that only live from the
+// G-buffer pass to the lighting pass, after which their pooled textures can back later targets.
+class GBuffer {
+public:
+    // Roughness GBuffer.frag writes for every mesh, shininess is 2^(10 (1 - roughness)),
+    // so 0.5 is close to the 33 Basic.frag uses
+    static constexpr float DefaultRoughness = 0.5f;
+
+    static constexpr GLenum AlbedoFormat = GL_RGBA8;
+    static constexpr GLenum NormalFormat = GL_RG16;
+    static constexpr GLenum DepthFormat = GL_DEPTH_COMPONENT32F;
+
+    // Color attachments plus depth
+    static constexpr int BytesPerPixel = 4 + 4 + 4;
+
+    struct Targets {
+        unsigned int albedo, normal, depth;
+    };
+
+public:
+    GBuffer(Shader& lightingShader, unsigned int quadVAO);
+
+    GBuffer(const GBuffer&) = delete;
+    GBuffer& operator=(const GBuffer&) = delete;
+
+    // Clears the bound G-buffer (albedo at location 0, normal at 1), the scene is then drawn with GBuffer.frag
+    void beginGeometry();
+
+    // Lights every pixel into the bound framebuffer, which must have the same size.
+    // Also writes the G-buffer depth there, so forward passes drawn afterwards are depth tested against the scene.
+    // Any other uniforms of DeferredLighting.frag (point lights) must be set beforehand.
+    void light(const Targets& targets, const CameraData& camera, const LightData& light);
+
+private:
+    Shader& lightingShader;
+    unsigned int quadVAO;
+};
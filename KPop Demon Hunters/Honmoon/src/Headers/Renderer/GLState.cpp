@@ -0,0 +1,291 @@
+#include "GLState.hpp"
+#include <array>
+
+namespace GLState {
+    namespace {
+        constexpr GLuint unknown = ~0u;
+
+        // -1 unknown, 0 disabled, 1 enabled
+        enum Capability { BLEND, DEPTH_TEST, CULL_FACE, RASTERIZER_DISCARD, CAPABILITY_COUNT };
+
+        struct Cache {
+            bool filtering = true;
+
+            GLuint program;
+            GLuint vertexArray;
+            GLenum activeUnit;
+            std::array<GLuint, textureUnits> textures2D;
+            std::array<GLuint, textureUnits> textures2DArray;
+            std::array<GLuint, textureUnits> samplers;
+            GLuint readFramebuffer;
+            GLuint drawFramebuffer;
+            std::array<GLint, 4> viewport;
+
+            std::array<int, CAPABILITY_COUNT> capabilities;
+            std::array<GLenum, 4> blendFunc;
+            GLenum depthFunc;
+            int depthMask;
+            int colorMask;
+            GLenum cullFace;
+
+            Counters counters;
+
+            Cache() { forget(); }
+
+            void forget() {
+                program = unknown;
+                vertexArray = unknown;
+                activeUnit = unknown;
+                textures2D.fill(unknown);
+                textures2DArray.fill(unknown);
+                samplers.fill(unknown);
+                readFramebuffer = unknown;
+                drawFramebuffer = unknown;
+                viewport.fill(-1);
+
+                capabilities.fill(-1);
+                blendFunc.fill(unknown);
+                depthFunc = unknown;
+                depthMask = -1;
+                colorMask = -1;
+                cullFace = unknown;
+            }
+        };
+
+        Cache& cache()
+        {
+            static Cache instance;
+            return instance;
+        }
+
+        // Updates the cached value, true if the call has to be issued
+        template<typename T>
+        bool changes(T& cached, const T& value)
+        {
+            Cache& state = cache();
+            if (state.filtering && cached == value) {
+                state.counters.filtered++;
+                return false;
+            }
+
+            cached = value;
+            state.counters.issued++;
+            return true;
+        }
+
+        int CapabilityIndex(GLenum capability)
+        {
+            switch (capability) {
+            case GL_BLEND: return BLEND;
+            case GL_DEPTH_TEST: return DEPTH_TEST;
+            case GL_CULL_FACE: return CULL_FACE;
+            case GL_RASTERIZER_DISCARD: return RASTERIZER_DISCARD;
+            default: return -1;
+            }
+        }
+
+        // Texture cache of the active unit for the target, nullptr if not tracked
+        GLuint* BoundTexture(GLenum target)
+        {
+            Cache& state = cache();
+            if (state.activeUnit == unknown) return nullptr;
+
+            GLuint unit = state.activeUnit - GL_TEXTURE0;
+            if (unit >= GLuint(textureUnits)) return nullptr;
+
+            if (target == GL_TEXTURE_2D) return &state.textures2D[unit];
+            if (target == GL_TEXTURE_2D_ARRAY) return &state.textures2DArray[unit];
+            return nullptr;
+        }
+    }
+
+    void SetFiltering(bool filtering)
+    {
+        cache().filtering = filtering;
+    }
+
+    void Invalidate()
+    {
+        cache().forget();
+    }
+
+    const Counters& GetCounters()
+    {
+        return cache().counters;
+    }
+
+    void ResetCounters()
+    {
+        cache().counters = Counters();
+    }
+
+    bool UseProgram(GLuint program)
+    {
+        if (!changes(cache().program, program)) return false;
+        glUseProgram(program);
+        return true;
+    }
+
+    bool BindVertexArray(GLuint vertexArray)
+    {
+        if (!changes(cache().vertexArray, vertexArray)) return false;
+        glBindVertexArray(vertexArray);
+        return true;
+    }
+
+    bool ActiveTexture(GLenum unit)
+    {
+        if (!changes(cache().activeUnit, unit)) return false;
+        glActiveTexture(unit);
+        return true;
+    }
+
+    bool BindTexture(GLenum target, GLuint texture)
+    {
+        GLuint* bound = BoundTexture(target);
+        if (!bound) {
+            cache().counters.issued++;
+            glBindTexture(target, texture);
+            return true;
+        }
+
+        if (!changes(*bound, texture)) return false;
+        glBindTexture(target, texture);
+        return true;
+    }
+
+    bool BindSampler(GLuint unit, GLuint sampler)
+    {
+        if (unit >= GLuint(textureUnits)) {
+            cache().counters.issued++;
+            glBindSampler(unit, sampler);
+            return true;
+        }
+
+        if (!changes(cache().samplers[unit], sampler)) return false;
+        glBindSampler(unit, sampler);
+        return true;
+    }
+
+    bool BindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        Cache& state = cache();
+
+        if (target == GL_READ_FRAMEBUFFER) {
+            if (!changes(state.readFramebuffer, framebuffer)) return false;
+        }
+        else if (target == GL_DRAW_FRAMEBUFFER) {
+            if (!changes(state.drawFramebuffer, framebuffer)) return false;
+        }
+        else {
+            // Both at once, filtered only if both already match
+            if (state.filtering && state.readFramebuffer == framebuffer && state.drawFramebuffer == framebuffer) {
+                state.counters.filtered++;
+                return false;
+            }
+            state.readFramebuffer = framebuffer;
+            state.drawFramebuffer = framebuffer;
+            state.counters.issued++;
+        }
+
+        glBindFramebuffer(target, framebuffer);
+        return true;
+    }
+
+    bool Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        if (!changes(cache().viewport, std::array<GLint, 4>{ x, y, width, height })) return false;
+        glViewport(x, y, width, height);
+        return true;
+    }
+
+    bool Enable(GLenum capability)
+    {
+        int index = CapabilityIndex(capability);
+        if (index < 0) {
+            cache().counters.issued++;
+            glEnable(capability);
+            return true;
+        }
+
+        if (!changes(cache().capabilities[index], 1)) return false;
+        glEnable(capability);
+        return true;
+    }
+
+    bool Disable(GLenum capability)
+    {
+        int index = CapabilityIndex(capability);
+        if (index < 0) {
+            cache().counters.issued++;
+            glDisable(capability);
+            return true;
+        }
+
+        if (!changes(cache().capabilities[index], 0)) return false;
+        glDisable(capability);
+        return true;
+    }
+
+    bool BlendFunc(GLenum source, GLenum destination)
+    {
+        if (!changes(cache().blendFunc, std::array<GLenum, 4>{ source, destination, source, destination })) return false;
+        glBlendFunc(source, destination);
+        return true;
+    }
+
+    bool BlendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha)
+    {
+        if (!changes(cache().blendFunc, std::array<GLenum, 4>{ sourceRGB, destinationRGB, sourceAlpha, destinationAlpha })) return false;
+        glBlendFuncSeparate(sourceRGB, destinationRGB, sourceAlpha, destinationAlpha);
+        return true;
+    }
+
+    void BlendFunci(GLuint buffer, GLenum source, GLenum destination)
+    {
+        Cache& state = cache();
+        state.blendFunc.fill(unknown);
+        state.counters.issued++;
+        glBlendFunci(buffer, source, destination);
+    }
+
+    bool DepthFunc(GLenum func)
+    {
+        if (!changes(cache().depthFunc, func)) return false;
+        glDepthFunc(func);
+        return true;
+    }
+
+    bool DepthMask(GLboolean flag)
+    {
+        if (!changes(cache().depthMask, flag ? 1 : 0)) return false;
+        glDepthMask(flag);
+        return true;
+    }
+
+    bool ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+    {
+        int mask = (red ? 1 : 0) | (green ? 2 : 0) | (blue ? 4 : 0) | (alpha ? 8 : 0);
+        if (!changes(cache().colorMask, mask)) return false;
+        glColorMask(red, green, blue, alpha);
+        return true;
+    }
+
+    bool CullFace(GLenum mode)
+    {
+        if (!changes(cache().cullFace, mode)) return false;
+        glCullFace(mode);
+        return true;
+    }
+
+    void DeleteTextures(GLsizei count, const GLuint* textures)
+    {
+        Cache& state = cache();
+        for (GLsizei i = 0; i < count; i++) {
+            for (GLuint& bound : state.textures2D) if (bound == textures[i]) bound = 0;
+            for (GLuint& bound : state.textures2DArray) if (bound == textures[i]) bound = 0;
+        }
+
+        glDeleteTextures(count, textures);
+    }
+}
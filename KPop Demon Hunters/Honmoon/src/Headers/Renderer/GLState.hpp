@@ -0,0 +1,51 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+
+// Thin tracking layer over the GL state the renderer changes most: program, vertex array, texture
+// units (2D and 2D array), samplers, blend/depth/cull/color state, framebuffers and viewport.
+// A call that would set what is already set is dropped before reaching the driver.
+// There is one cache for the one context, used by whichever thread currently owns it.
+// Anything that changes this state without going through here (ImGui's backend) must call Invalidate() after.
+namespace GLState {
+    constexpr int textureUnits = 16;
+
+    // Calls per frame that reached the driver and calls dropped as redundant
+    struct Counters {
+        unsigned int issued = 0;
+        unsigned int filtered = 0;
+    };
+
+    // Off, every call is issued (and counted), for comparison
+    void SetFiltering(bool filtering);
+    // Forgets everything, the next call of each kind is issued
+    void Invalidate();
+
+    const Counters& GetCounters();
+    void ResetCounters();
+
+    // Each returns true if the call was issued
+    bool UseProgram(GLuint program);
+    bool BindVertexArray(GLuint vertexArray);
+    bool ActiveTexture(GLenum unit);
+    bool BindTexture(GLenum target, GLuint texture);
+    bool BindSampler(GLuint unit, GLuint sampler);
+    bool BindFramebuffer(GLenum target, GLuint framebuffer);
+    bool Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    // Tracks GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_RASTERIZER_DISCARD, anything else is passed through
+    bool Enable(GLenum capability);
+    bool Disable(GLenum capability);
+
+    bool BlendFunc(GLenum source, GLenum destination);
+    bool BlendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha);
+    // Per draw buffer, always issued, the shared blend function is unknown afterwards
+    void BlendFunci(GLuint buffer, GLenum source, GLenum destination);
+    bool DepthFunc(GLenum func);
+    bool DepthMask(GLboolean flag);
+    bool ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+    bool CullFace(GLenum mode);
+
+    // Deleting a bound texture unbinds it, the cache has to know
+    void DeleteTextures(GLsizei count, const GLuint* textures);
+}
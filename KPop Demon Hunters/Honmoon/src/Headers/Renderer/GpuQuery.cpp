@@ -0,0 +1,48 @@
+#include "GpuQuery.hpp"
+
+GpuQuery::GpuQuery(GLenum target)
+    : target(target)
+{
+    if (target == GL_VERTICES_SUBMITTED || target == GL_PRIMITIVES_SUBMITTED || target == GL_FRAGMENT_SHADER_INVOCATIONS ||
+        target == GL_VERTEX_SHADER_INVOCATIONS || target == GL_CLIPPING_INPUT_PRIMITIVES || target == GL_CLIPPING_OUTPUT_PRIMITIVES)
+        supported = PipelineStatisticsSupported();
+
+    if (supported) glGenQueries(1, &query);
+}
+
+bool GpuQuery::PipelineStatisticsSupported()
+{
+    return GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_pipeline_statistics_query;
+}
+
+bool GpuQuery::begin()
+{
+    poll();
+    if (!supported || pending) return false;
+
+    glBeginQuery(target, query);
+    active = true;
+    return true;
+}
+
+void GpuQuery::end()
+{
+    if (!active) return;
+
+    glEndQuery(target);
+    active = false;
+    pending = true;
+}
+
+bool GpuQuery::poll()
+{
+    if (!pending) return false;
+
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+    pending = false;
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+
+// One query object read back without stalling: a new range is only measured once the result
+// of the previous one has arrived, so some frames go unmeasured instead of waiting on the GPU.
+// Works for GL_TIME_ELAPSED, GL_SAMPLES_PASSED and the pipeline statistics targets
+// (GL_FRAGMENT_SHADER_INVOCATIONS...), which need GL 4.6 or ARB_pipeline_statistics_query.
+class GpuQuery {
+public:
+    explicit GpuQuery(GLenum target);
+
+    GpuQuery(const GpuQuery&) = delete;
+    GpuQuery& operator=(const GpuQuery&) = delete;
+
+    // Returns false if the range is not measured, end() is then a no-op
+    bool begin();
+    void end();
+
+    // Picks up the result once the GPU has it, true if a new one just arrived
+    bool poll();
+
+    GLuint64 getResult() const { return result; }
+    bool isSupported() const { return supported; }
+
+    static bool PipelineStatisticsSupported();
+
+private:
+    GLenum target;
+    unsigned int query = 0;
+    bool supported = true;
+    bool active = false;
+    bool pending = false;
+    GLuint64 result = 0;
+};
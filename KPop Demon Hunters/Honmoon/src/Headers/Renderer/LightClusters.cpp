@@ -0,0 +1,171 @@
+#include "LightClusters.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+LightClusters::LightClusters()
+    : sliceIndices(slices), ranges(clusterCount)
+{
+    glGenBuffers(1, &lightBuffer);
+    glGenBuffers(1, &clusterBuffer);
+    glGenBuffers(1, &indexBuffer);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, clusterCount * sizeof(ClusterRange), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightClusters::buildBounds(const glm::mat4& projection, int width, int height)
+{
+    boundsProjection = projection;
+    boundsWidth = width;
+    boundsHeight = height;
+
+    // Perspective projection only
+    nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+    // Tiles are whole pixels, the last row and column may reach past the screen
+    float tileWidth = std::ceil(width / float(tilesX));
+    float tileHeight = std::ceil(height / float(tilesY));
+
+    bounds.resize(clusterCount);
+    for (int z = 0; z < slices; z++) {
+        float sliceNear = nearPlane * std::pow(farPlane / nearPlane, z / float(slices));
+        float sliceFar = nearPlane * std::pow(farPlane / nearPlane, (z + 1) / float(slices));
+
+        for (int y = 0; y < tilesY; y++) {
+            for (int x = 0; x < tilesX; x++) {
+                ClusterBounds& cluster = bounds[(z * tilesY + y) * tilesX + x];
+                cluster.min = glm::vec3(std::numeric_limits<float>::max());
+                cluster.max = glm::vec3(-std::numeric_limits<float>::max());
+
+                for (int corner = 0; corner < 4; corner++) {
+                    float ndcX = (x + (corner & 1)) * tileWidth / width * 2.0f - 1.0f;
+                    float ndcY = (y + (corner >> 1)) * tileHeight / height * 2.0f - 1.0f;
+
+                    // Point of the corner ray at view depth d is (d (ndc + P20) / P00, d (ndc + P21) / P11, -d)
+                    for (float depth : { sliceNear, sliceFar }) {
+                        glm::vec3 point(depth * (ndcX + projection[2][0]) / projection[0][0],
+                                        depth * (ndcY + projection[2][1]) / projection[1][1],
+                                        -depth);
+                        cluster.min = glm::min(cluster.min, point);
+                        cluster.max = glm::max(cluster.max, point);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LightClusters::update(const std::shared_ptr<const PointLightList>& lights, const CameraData& camera, int width, int height, WorkerPool& workers)
+{
+    if (lights != uploaded) {
+        lightCount = lights ? lights->size() : 0;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(lightCount, size_t(1)) * sizeof(PointLight), lightCount ? lights->data() : nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        uploaded = lights;
+        uploads++;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (camera.projectionMatrix != boundsProjection || width != boundsWidth || height != boundsHeight)
+        buildBounds(camera.projectionMatrix, width, height);
+
+    viewLights.resize(lightCount);
+    for (size_t i = 0; i < lightCount; i++) {
+        const PointLight& light = (*lights)[i];
+        viewLights[i] = glm::vec4(glm::vec3(camera.viewMatrix * glm::vec4(light.position, 1.0f)), light.radius);
+    }
+
+    float logRatio = std::log(farPlane / nearPlane);
+
+    // One slice per job, every slice only writes its own clusters and index list
+    workers.parallelFor(slices, [&](size_t begin, size_t end, unsigned int) {
+        std::vector<GLuint> candidates;
+
+        for (size_t z = begin; z < end; z++) {
+            std::vector<GLuint>& sliceList = sliceIndices[z];
+            sliceList.clear();
+
+            // Lights reaching into the slice's depth range
+            float sliceNear = nearPlane * std::exp(logRatio * z / slices);
+            float sliceFar = nearPlane * std::exp(logRatio * (z + 1) / slices);
+
+            candidates.clear();
+            for (size_t i = 0; i < viewLights.size(); i++) {
+                float depth = -viewLights[i].z;
+                if (depth + viewLights[i].w >= sliceNear && depth - viewLights[i].w <= sliceFar)
+                    candidates.push_back(GLuint(i));
+            }
+
+            for (int tile = 0; tile < tilesX * tilesY; tile++) {
+                int cluster = int(z) * tilesX * tilesY + tile;
+                const ClusterBounds& box = bounds[cluster];
+
+                ClusterRange& range = ranges[cluster];
+                range.offset = GLuint(sliceList.size());
+
+                for (GLuint i : candidates) {
+                    glm::vec3 center = glm::vec3(viewLights[i]);
+                    glm::vec3 closest = glm::clamp(center, box.min, box.max);
+                    glm::vec3 offset = center - closest;
+
+                    if (glm::dot(offset, offset) <= viewLights[i].w * viewLights[i].w)
+                        sliceList.push_back(i);
+                }
+
+                range.count = GLuint(sliceList.size()) - range.offset;
+            }
+        }
+    });
+
+    // Slices back to back, offsets made global
+    indices.clear();
+    occupiedClusters = 0;
+    maxLightsPerCluster = 0;
+    for (int z = 0; z < slices; z++) {
+        GLuint base = GLuint(indices.size());
+        for (int tile = 0; tile < tilesX * tilesY; tile++) {
+            ClusterRange& range = ranges[z * tilesX * tilesY + tile];
+            range.offset += base;
+            if (range.count > 0) occupiedClusters++;
+            maxLightsPerCluster = std::max(maxLightsPerCluster, int(range.count));
+        }
+        indices.insert(indices.end(), sliceIndices[z].begin(), sliceIndices[z].end());
+    }
+    indexCount = indices.size();
+
+    assignMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, clusterCount * sizeof(ClusterRange), ranges.data());
+
+    // Grows by doubling, orphaned every frame otherwise
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+    if (indexCount > indexCapacity || indexCapacity == 0) indexCapacity = std::max(indexCapacity * 2, std::max(indexCount, size_t(1024)));
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indexCapacity * sizeof(GLuint), nullptr, GL_STREAM_DRAW);
+    if (indexCount) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, indexCount * sizeof(GLuint), indices.data());
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightClusters::bind(const Shader& shader) const
+{
+    float logRatio = std::log(farPlane / nearPlane);
+
+    shader.setBool("useClusteredLights", true);
+    shader.setiVec3("clusterGrid", glm::ivec3(tilesX, tilesY, slices));
+    shader.setVec2("clusterTileSize", std::ceil(boundsWidth / float(tilesX)), std::ceil(boundsHeight / float(tilesY)));
+    // slice = log(depth) * scale + bias
+    shader.setVec2("clusterSlicing", slices / logRatio, -slices * std::log(nearPlane) / logRatio);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, lightBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, clusterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, indexBuffer);
+}
@@ -0,0 +1,83 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// Other
+#include <memory>
+#include <vector>
+// My headers
+#include "FramePacket.hpp"
+#include "../Shaders/Shader.hpp"
+#include "../Threading/WorkerPool.hpp"
+
+// Clustered point lights. The view frustum is split into a froxel grid, screen tiles times slices
+// spaced exponentially in depth, and every frame each cluster gets the list of lights whose sphere
+// touches its view space bounds. The slices are assigned on the worker threads, in parallel.
+// Basic.frag and DeferredLighting.frag only loop over the lights of their own cluster,
+// so shading cost follows how many lights overlap a point rather than how many there are.
+class LightClusters {
+public:
+    static constexpr int tilesX = 16;
+    static constexpr int tilesY = 9;
+    static constexpr int slices = 24;
+    static constexpr int clusterCount = tilesX * tilesY * slices;
+
+public:
+    LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // Uploads the lights if the list changed, then rebuilds the cluster lists for this camera
+    void update(const std::shared_ptr<const PointLightList>& lights, const CameraData& camera, int width, int height, WorkerPool& workers);
+
+    // Sets the cluster uniforms of Basic.frag or DeferredLighting.frag, which must be in use, and binds the buffers
+    void bind(const Shader& shader) const;
+
+    size_t getLightCount() const { return lightCount; }
+    size_t getIndexCount() const { return indexCount; }
+    int getOccupiedClusters() const { return occupiedClusters; }
+    int getMaxLightsPerCluster() const { return maxLightsPerCluster; }
+    unsigned int getUploadCount() const { return uploads; }
+    float getAssignMs() const { return assignMs; }
+
+private:
+    void buildBounds(const glm::mat4& projection, int width, int height);
+
+private:
+    // Matches LightClusters in Basic.frag, offset into the index list and count
+    struct ClusterRange {
+        GLuint offset;
+        GLuint count;
+    };
+
+    struct ClusterBounds {
+        glm::vec3 min, max;
+    };
+
+    unsigned int lightBuffer = 0;
+    unsigned int clusterBuffer = 0;
+    unsigned int indexBuffer = 0;
+    size_t indexCapacity = 0;
+
+    std::shared_ptr<const PointLightList> uploaded;
+    size_t lightCount = 0;
+    unsigned int uploads = 0;
+
+    // View space bounds, rebuilt when the projection or the screen size changes
+    glm::mat4 boundsProjection = glm::mat4(0.0f);
+    int boundsWidth = 0, boundsHeight = 0;
+    std::vector<ClusterBounds> bounds;
+    float nearPlane = 0.1f, farPlane = 100.0f;
+
+    std::vector<glm::vec4> viewLights;                  // view space position, radius
+    std::vector<std::vector<GLuint>> sliceIndices;      // written by one worker each
+    std::vector<ClusterRange> ranges;
+    std::vector<GLuint> indices;
+
+    size_t indexCount = 0;
+    int occupiedClusters = 0;
+    int maxLightsPerCluster = 0;
+    float assignMs = 0.0f;
+};
@@ -0,0 +1,67 @@
+#include "LowResPass.hpp"
+#include "GLState.hpp"
+
+LowResPass::LowResPass(Shader& downsampleShader, Shader& upsampleShader, unsigned int quadVAO)
+    : downsampleShader(downsampleShader), upsampleShader(upsampleShader), quadVAO(quadVAO)
+{
+}
+
+void LowResPass::downsampleDepth(unsigned int sceneDepth)
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Depth only, every texel written whatever was there
+    GLState::ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    GLState::DepthFunc(GL_ALWAYS);
+
+    downsampleShader.use();
+    downsampleShader.setInt("sceneDepth", 0);
+    downsampleShader.setInt("divisor", divisor);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, sceneDepth);
+    GLState::BindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    GLState::BindVertexArray(0);
+
+    GLState::DepthFunc(GL_LESS);
+    GLState::ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // The depth stays the scene's, the upsampling compares against it
+    GLState::DepthMask(GL_FALSE);
+    GLState::BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void LowResPass::composite(unsigned int sceneFramebuffer, const Targets& targets, int width, int height, const glm::mat4& projection)
+{
+    GLState::DepthMask(GL_TRUE);
+
+    // Only the read side changes, the draw side stays the bound target
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    GLState::Disable(GL_DEPTH_TEST);
+    GLState::BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    upsampleShader.use();
+    upsampleShader.setInt("sceneDepth", 0);
+    upsampleShader.setInt("lowDepth", 1);
+    upsampleShader.setInt("lowColor", 2);
+    upsampleShader.setVec2("depthParams", projection[2][2], projection[3][2]);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, targets.sceneDepth);
+    GLState::ActiveTexture(GL_TEXTURE1);
+    GLState::BindTexture(GL_TEXTURE_2D, targets.lowDepth);
+    GLState::ActiveTexture(GL_TEXTURE2);
+    GLState::BindTexture(GL_TEXTURE_2D, targets.lowColor);
+
+    GLState::BindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    GLState::BindVertexArray(0);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::Enable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,51 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// GLM
+#include <glm/glm.hpp>
+// My headers
+#include "../Shaders/Shader.hpp"
+
+// Draws translucent passes at a fraction of the screen resolution.
+// The scene goes to an offscreen target instead of the window so its depth can be read,
+// the depth is downsampled into the low resolution target for the depth test, and the result
+// is blended over the scene with a depth aware (bilateral) upsampling that keeps edges sharp.
+// The scene, low resolution color and low resolution depth are render graph transients, the
+// low resolution ones declared with getDivisor() so their size follows the screen on its own.
+class LowResPass {
+public:
+    static constexpr GLenum SceneColorFormat = GL_RGBA8;
+    static constexpr GLenum LowColorFormat = GL_RGBA16F;
+    static constexpr GLenum DepthFormat = GL_DEPTH_COMPONENT32F;
+
+    // What composite samples, the low resolution sides are the full ones divided by the divisor
+    struct Targets {
+        unsigned int sceneDepth;
+        unsigned int lowColor, lowDepth;
+    };
+
+public:
+    LowResPass(Shader& downsampleShader, Shader& upsampleShader, unsigned int quadVAO);
+
+    LowResPass(const LowResPass&) = delete;
+    LowResPass& operator=(const LowResPass&) = delete;
+
+    // divisor is the full resolution texels per low resolution texel, per side
+    void setDivisor(int divisor) { this->divisor = divisor; }
+    int getDivisor() const { return divisor; }
+
+    // Downsamples the scene depth into the bound low resolution target and clears its color.
+    // Depth writes are then off and blending accumulates premultiplied color until composite.
+    void downsampleDepth(unsigned int sceneDepth);
+
+    // Copies the scene color from sceneFramebuffer into the bound framebuffer, both width x height,
+    // and blends the low resolution target over it
+    void composite(unsigned int sceneFramebuffer, const Targets& targets, int width, int height, const glm::mat4& projection);
+
+private:
+    int divisor = 2;
+
+    Shader& downsampleShader;
+    Shader& upsampleShader;
+    unsigned int quadVAO;
+};
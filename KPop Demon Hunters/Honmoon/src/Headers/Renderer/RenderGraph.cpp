@@ -0,0 +1,453 @@
+#include "RenderGraph.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <queue>
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(Resource resource)
+{
+    graph.passes[pass].reads.push_back(resource);
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(Resource resource)
+{
+    graph.passes[pass].colors.push_back(resource);
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::writeStorage(Resource resource)
+{
+    graph.passes[pass].storage.push_back(resource);
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::writeDepth(Resource resource)
+{
+    graph.passes[pass].depth = resource;
+    graph.passes[pass].depthWritten = true;
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::readDepth(Resource resource)
+{
+    graph.passes[pass].depth = resource;
+    graph.passes[pass].depthWritten = false;
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::sideEffect()
+{
+    graph.passes[pass].sideEffect = true;
+    return *this;
+}
+
+void RenderGraph::reset(int screenWidth, int screenHeight)
+{
+    // A minimized window reports 0
+    this->screenWidth = std::max(screenWidth, 1);
+    this->screenHeight = std::max(screenHeight, 1);
+
+    resources.clear();
+    passes.clear();
+    order.clear();
+
+    // A cached framebuffer of an import would keep its old storage alive, or match a new texture
+    // that reused the name
+    for (const std::vector<unsigned int>& key : importedFramebuffers) releaseFramebuffer(key);
+    importedFramebuffers.clear();
+
+    importTexture("Backbuffer", 0, this->screenWidth, this->screenHeight);
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const std::string& name, const TextureDesc& desc)
+{
+    ResourceNode& resource = resources.emplace_back();
+    resource.name = name;
+    resource.desc = desc;
+
+    if (desc.width > 0 && desc.height > 0) {
+        resource.width = desc.width;
+        resource.height = desc.height;
+    }
+    else {
+        resource.width = std::max(screenWidth / desc.divisor, 1);
+        resource.height = std::max(screenHeight / desc.divisor, 1);
+    }
+
+    return Resource(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const std::string& name, unsigned int texture, int width, int height)
+{
+    ResourceNode& resource = resources.emplace_back();
+    resource.name = name;
+    resource.imported = true;
+    resource.texture = texture;
+    resource.width = width;
+    resource.height = height;
+
+    return Resource(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const std::string& name)
+{
+    ResourceNode& resource = resources.emplace_back();
+    resource.name = name;
+    resource.imported = true;
+
+    return Resource(resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const std::string& name, Execute execute)
+{
+    PassNode& pass = passes.emplace_back();
+    pass.name = name;
+    pass.execute = std::move(execute);
+
+    return PassBuilder(*this, int(passes.size()) - 1);
+}
+
+void RenderGraph::compile()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Backwards from the outputs: a pass is kept if it has effects outside the graph or writes something
+    // a kept pass needs. Everything it touches is then needed before it, its writes too since it may
+    // only blend over them. Swept again until nothing changes, a writer declared after its reader is
+    // only reached by the next sweep.
+    std::vector<bool> kept(passes.size(), false);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = int(passes.size()) - 1; i >= 0; i--) {
+            if (kept[i]) continue;
+            const PassNode& pass = passes[i];
+
+            bool keep = pass.sideEffect;
+            for (Resource resource : pass.colors)
+                keep = keep || resources[resource].needed || resources[resource].imported;
+            for (Resource resource : pass.storage)
+                keep = keep || resources[resource].needed || resources[resource].imported;
+            if (pass.depth >= 0 && pass.depthWritten)
+                keep = keep || resources[pass.depth].needed || resources[pass.depth].imported;
+            if (!keep) continue;
+
+            kept[i] = true;
+            changed = true;
+            for (Resource resource : pass.reads) resources[resource].needed = true;
+            for (Resource resource : pass.colors) resources[resource].needed = true;
+            for (Resource resource : pass.storage) resources[resource].needed = true;
+            if (pass.depth >= 0) resources[pass.depth].needed = true;
+        }
+    }
+
+    sort(kept);
+
+    stats.order.clear();
+    for (int step = 0; step < int(order.size()); step++) {
+        const PassNode& pass = passes[order[step]];
+        for (Resource resource : pass.reads) use(resource, step);
+        for (Resource resource : pass.colors) use(resource, step);
+        for (Resource resource : pass.storage) use(resource, step);
+        if (pass.depth >= 0) use(pass.depth, step);
+
+        if (!stats.order.empty()) stats.order += " > ";
+        stats.order += pass.name;
+    }
+
+    allocate();
+
+    stats.passes = int(passes.size());
+    stats.culled = int(passes.size() - order.size());
+    stats.compileMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool RenderGraph::PassNode::readsResource(Resource resource) const
+{
+    if (depth == resource && !depthWritten) return true;
+    return std::find(reads.begin(), reads.end(), resource) != reads.end();
+}
+
+bool RenderGraph::PassNode::writesResource(Resource resource) const
+{
+    if (depth == resource && depthWritten) return true;
+    return std::find(colors.begin(), colors.end(), resource) != colors.end() || std::find(storage.begin(), storage.end(), resource) != storage.end();
+}
+
+void RenderGraph::sort(const std::vector<bool>& kept)
+{
+    // Per resource, in declaration order: a read waits for the writes declared before it, a write for
+    // the earlier writes and for the reads of what they wrote. A transient read before any write can
+    // only mean the passes were declared out of order, so it waits for every later write instead.
+    int count = int(passes.size());
+    std::vector<std::vector<int>> dependents(count);
+    std::vector<int> waiting(count, 0);
+    auto depend = [&](int before, int after) {
+        dependents[before].push_back(after);
+        waiting[after]++;
+    };
+
+    for (Resource resource = 0; resource < Resource(resources.size()); resource++) {
+        std::vector<int> writers, readers, early;
+        for (int i = 0; i < count; i++) {
+            if (!kept[i]) continue;
+            bool reads = passes[i].readsResource(resource);
+            bool writes = passes[i].writesResource(resource);
+
+            if (reads && !writers.empty()) {
+                for (int writer : writers) depend(writer, i);
+                readers.push_back(i);
+            }
+            else if (reads && !writes && !resources[resource].imported) {
+                early.push_back(i);
+            }
+
+            if (writes) {
+                if (!reads) for (int writer : writers) depend(writer, i);
+                for (int reader : readers) if (reader != i) depend(reader, i);
+                for (int reader : early) depend(i, reader);
+                writers.push_back(i);
+            }
+        }
+
+        if (writers.empty()) {
+            for (int reader : early)
+                std::cout << "Render graph: " << passes[reader].name << " reads " << resources[resource].name << ", which no pass writes" << std::endl;
+            assert(early.empty());
+        }
+    }
+
+    // Lowest declaration index first, so an order that already respects every dependency is kept as is
+    std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+    int keptCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (!kept[i]) continue;
+        keptCount++;
+        if (waiting[i] == 0) ready.push(i);
+    }
+
+    order.clear();
+    while (!ready.empty()) {
+        int pass = ready.top();
+        ready.pop();
+        order.push_back(pass);
+
+        for (int dependent : dependents[pass])
+            if (--waiting[dependent] == 0) ready.push(dependent);
+    }
+
+    if (int(order.size()) != keptCount) {
+        std::cout << "Render graph: the passes depend on each other in a cycle, running them in declaration order" << std::endl;
+        assert(false);
+
+        order.clear();
+        for (int i = 0; i < count; i++)
+            if (kept[i]) order.push_back(i);
+    }
+}
+
+void RenderGraph::use(Resource resource, int step)
+{
+    ResourceNode& node = resources[resource];
+    if (node.firstPass < 0) node.firstPass = step;
+    node.lastPass = step;
+}
+
+static unsigned int CreateTarget(GLenum internalFormat, int width, int height)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    GLState::BindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return texture;
+}
+
+void RenderGraph::allocate()
+{
+    for (PooledTexture& pooled : pool) {
+        pooled.busyUntil = -1;
+        pooled.used = false;
+    }
+
+    stats.targets = 0;
+    stats.unaliasedBytes = 0;
+
+    // In execution order, a texture is free again once the last pass of its previous target has run
+    for (int step = 0; step < int(order.size()); step++) {
+        for (ResourceNode& resource : resources) {
+            if (resource.imported || resource.firstPass != step) continue;
+
+            int found = -1;
+            for (int i = 0; i < int(pool.size()) && found < 0; i++) {
+                const PooledTexture& pooled = pool[i];
+                if (pooled.busyUntil < step && pooled.format == resource.desc.format && pooled.width == resource.width && pooled.height == resource.height)
+                    found = i;
+            }
+
+            if (found < 0) {
+                PooledTexture& pooled = pool.emplace_back();
+                pooled.texture = CreateTarget(resource.desc.format, resource.width, resource.height);
+                pooled.format = resource.desc.format;
+                pooled.width = resource.width;
+                pooled.height = resource.height;
+                found = int(pool.size()) - 1;
+                stats.allocations++;
+            }
+
+            pool[found].busyUntil = resource.lastPass;
+            pool[found].used = true;
+            resource.pooled = found;
+
+            stats.targets++;
+            stats.unaliasedBytes += size_t(resource.width) * resource.height * BytesPerTexel(resource.desc.format);
+        }
+    }
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
+
+    // Whatever this frame did not need goes, old sizes after a resize included
+    std::vector<int> remap(pool.size(), -1);
+    std::vector<PooledTexture> remaining;
+    for (int i = 0; i < int(pool.size()); i++) {
+        if (pool[i].used) {
+            remap[i] = int(remaining.size());
+            remaining.push_back(pool[i]);
+        }
+        else {
+            GLState::DeleteTextures(1, &pool[i].texture);
+        }
+    }
+
+    if (remaining.size() != pool.size()) {
+        releaseFramebuffers();
+        pool = std::move(remaining);
+        for (ResourceNode& resource : resources)
+            if (resource.pooled >= 0) resource.pooled = remap[resource.pooled];
+    }
+
+    stats.textures = int(pool.size());
+    stats.bytes = 0;
+    for (const PooledTexture& pooled : pool)
+        stats.bytes += size_t(pooled.width) * pooled.height * BytesPerTexel(pooled.format);
+}
+
+void RenderGraph::execute()
+{
+    for (int index : order) {
+        const PassNode& pass = passes[index];
+
+        bool toWindow = std::find(pass.colors.begin(), pass.colors.end(), getBackbuffer()) != pass.colors.end() || pass.depth == getBackbuffer();
+        if (toWindow) {
+            boundFramebuffer = 0;
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+            GLState::Viewport(0, 0, screenWidth, screenHeight);
+        }
+        else if (!pass.colors.empty() || pass.depth >= 0) {
+            Resource first = pass.colors.empty() ? pass.depth : pass.colors[0];
+            boundFramebuffer = framebufferFor(pass.colors, pass.depth);
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, boundFramebuffer);
+            GLState::Viewport(0, 0, getWidth(first), getHeight(first));
+        }
+
+        pass.execute(*this);
+    }
+
+    // The GUI draws after the graph
+    boundFramebuffer = 0;
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::Viewport(0, 0, screenWidth, screenHeight);
+}
+
+unsigned int RenderGraph::getTexture(Resource resource) const
+{
+    const ResourceNode& node = resources[resource];
+    if (node.imported) return node.texture;
+    return node.pooled >= 0 ? pool[node.pooled].texture : 0;
+}
+
+unsigned int RenderGraph::getFramebuffer(Resource resource) const
+{
+    if (resource == getBackbuffer()) return 0;
+    return framebufferFor({ resource }, -1);
+}
+
+unsigned int RenderGraph::framebufferFor(const std::vector<Resource>& colors, Resource depth) const
+{
+    std::vector<unsigned int> key;
+    key.push_back((unsigned int)colors.size());
+    for (Resource resource : colors) key.push_back(getTexture(resource));
+    key.push_back(depth >= 0 ? getTexture(depth) : 0);
+
+    auto cached = framebuffers.find(key);
+    if (cached != framebuffers.end()) return cached->second;
+
+    bool attachesImport = depth >= 0 && resources[depth].imported;
+    for (Resource resource : colors) attachesImport = attachesImport || resources[resource].imported;
+    if (attachesImport) importedFramebuffers.push_back(key);
+
+    unsigned int FBO;
+    glGenFramebuffers(1, &FBO);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    std::vector<GLenum> drawBuffers;
+    for (size_t i = 0; i < colors.size(); i++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GLenum(GL_COLOR_ATTACHMENT0 + i), GL_TEXTURE_2D, getTexture(colors[i]), 0);
+        drawBuffers.push_back(GLenum(GL_COLOR_ATTACHMENT0 + i));
+    }
+    if (depth >= 0)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, getTexture(depth), 0);
+
+    if (drawBuffers.empty()) glDrawBuffer(GL_NONE);
+    else glDrawBuffers(GLsizei(drawBuffers.size()), drawBuffers.data());
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, boundFramebuffer);
+
+    framebuffers[key] = FBO;
+    return FBO;
+}
+
+void RenderGraph::releaseFramebuffers()
+{
+    // Deleting the bound framebuffer would leave GLState out of date
+    boundFramebuffer = 0;
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (const auto& framebuffer : framebuffers)
+        glDeleteFramebuffers(1, &framebuffer.second);
+    framebuffers.clear();
+    importedFramebuffers.clear();
+}
+
+void RenderGraph::releaseFramebuffer(const std::vector<unsigned int>& key)
+{
+    auto cached = framebuffers.find(key);
+    if (cached == framebuffers.end()) return;
+
+    if (boundFramebuffer == cached->second) boundFramebuffer = 0;
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glDeleteFramebuffers(1, &cached->second);
+    framebuffers.erase(cached);
+}
+
+size_t RenderGraph::BytesPerTexel(GLenum format)
+{
+    switch (format) {
+    case GL_R8:                 return 1;
+    case GL_RGBA16F:
+    case GL_RG32F:              return 8;
+    case GL_RGBA32F:            return 16;
+    default:                    return 4;   // RGBA8, RG16, R32F, DEPTH_COMPONENT32F
+    }
+}
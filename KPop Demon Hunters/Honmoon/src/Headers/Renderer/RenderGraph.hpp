@@ -0,0 +1,159 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// Other
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Frame described as passes that declare the textures they read and write, rebuilt every frame.
+// compile() culls the passes nothing needs, gives each transient texture the lifetime of its first
+// to last user, and backs them with pooled textures, two targets with the same format and size
+// sharing one when their lifetimes do not overlap. execute() binds each pass's attachments and viewport
+// and runs it. Transient sizes follow the screen size given to reset(), which is the only place a
+// window resize has to reach.
+// The kept passes are sorted from what they read and write: a read follows the writes declared
+// before it, or every write if the resource was read before anything wrote it. Among passes free to
+// run, the first declared goes first, so a frame declared in order runs in that order.
+class RenderGraph {
+public:
+    // Texture declared this frame, only valid until the next reset
+    using Resource = int;
+    using Execute = std::function<void(const RenderGraph& graph)>;
+
+    // Transient texture, screen sized divided by divisor unless a fixed size is given
+    struct TextureDesc {
+        GLenum format = GL_RGBA8;
+        int divisor = 1;
+        int width = 0, height = 0;
+    };
+
+    class PassBuilder {
+    public:
+        PassBuilder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+
+        // Sampled by the pass
+        PassBuilder& read(Resource resource);
+        // Color attachments, in call order from location 0. Writing the backbuffer draws to the window.
+        PassBuilder& write(Resource resource);
+        // Written through image stores or compute, not as an attachment, so nothing is bound for it
+        PassBuilder& writeStorage(Resource resource);
+        // Depth attachment the pass writes
+        PassBuilder& writeDepth(Resource resource);
+        // Depth attachment the pass only tests against
+        PassBuilder& readDepth(Resource resource);
+        // Never culled, for passes whose effects the graph cannot see (buffers, readbacks)
+        PassBuilder& sideEffect();
+
+    private:
+        RenderGraph& graph;
+        int pass;
+    };
+
+    // Of the last compile
+    struct Stats {
+        int passes = 0;
+        int culled = 0;
+        std::string order;              // executed passes
+        int targets = 0;                // transient textures used
+        int textures = 0;               // pooled textures backing them
+        size_t bytes = 0;
+        size_t unaliasedBytes = 0;      // with one texture per target
+        unsigned int allocations = 0;   // textures created so far
+        float compileMs = 0.0f;
+    };
+
+public:
+    RenderGraph() = default;
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Drops last frame's passes and resources, the pool is kept
+    void reset(int screenWidth, int screenHeight);
+
+    Resource createTexture(const std::string& name, const TextureDesc& desc);
+    // Owned elsewhere and kept across frames, so writing one counts as a side effect
+    Resource importTexture(const std::string& name, unsigned int texture, int width, int height);
+    // Storage buffer owned elsewhere. The graph never binds it, it only orders the passes that fill it
+    // with writeStorage before those that read it.
+    Resource importBuffer(const std::string& name);
+    // The window, what every frame ends up in
+    Resource getBackbuffer() const { return 0; }
+
+    PassBuilder addPass(const std::string& name, Execute execute);
+
+    void compile();
+    void execute();
+
+    // During execute
+    unsigned int getTexture(Resource resource) const;
+    int getWidth(Resource resource) const { return resources[resource].width; }
+    int getHeight(Resource resource) const { return resources[resource].height; }
+    // Framebuffer with the texture as its only color attachment, to blit from
+    unsigned int getFramebuffer(Resource resource) const;
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        int width = 0, height = 0;
+        bool imported = false;
+        unsigned int texture = 0;       // imported only
+        bool needed = false;
+        int firstPass = -1, lastPass = -1;  // in execution order
+        int pooled = -1;
+    };
+
+    struct PassNode {
+        std::string name;
+        Execute execute;
+        std::vector<Resource> reads;
+        std::vector<Resource> colors;
+        std::vector<Resource> storage;
+        Resource depth = -1;
+        bool depthWritten = false;
+        bool sideEffect = false;
+
+        bool readsResource(Resource resource) const;
+        bool writesResource(Resource resource) const;
+    };
+
+    struct PooledTexture {
+        unsigned int texture = 0;
+        GLenum format = GL_RGBA8;
+        int width = 0, height = 0;
+        int busyUntil = -1;     // last pass of its current target this frame
+        bool used = false;
+    };
+
+    // Fills order with the kept passes, dependencies first
+    void sort(const std::vector<bool>& kept);
+    void allocate();
+    void use(Resource resource, int pass);
+    unsigned int framebufferFor(const std::vector<Resource>& colors, Resource depth) const;
+    void releaseFramebuffers();
+    void releaseFramebuffer(const std::vector<unsigned int>& key);
+
+    static size_t BytesPerTexel(GLenum format);
+
+private:
+    int screenWidth = 1, screenHeight = 1;
+
+    std::vector<ResourceNode> resources;
+    std::vector<PassNode> passes;
+    std::vector<int> order;
+
+    std::vector<PooledTexture> pool;
+    // What execute bound for the running pass, a framebuffer created during it must not change that
+    mutable unsigned int boundFramebuffer = 0;
+    // Color count, color textures and depth texture (0 if none) to framebuffer
+    mutable std::map<std::vector<unsigned int>, unsigned int> framebuffers;
+    // Keys of those attaching an import, whose texture may be recreated under the same name between frames
+    mutable std::vector<std::vector<unsigned int>> importedFramebuffers;
+
+    Stats stats;
+};
@@ -0,0 +1,48 @@
+#include "RenderQueue.hpp"
+#include <algorithm>
+#include <array>
+
+uint64_t RenderQueue::MakeKey(unsigned int pass, bool translucent, unsigned int shader, unsigned int material, float depth, float maxDepth)
+{
+    constexpr uint64_t depthMax = (uint64_t(1) << depthBits) - 1;
+
+    float normalized = maxDepth > 0.0f ? std::clamp(depth / maxDepth, 0.0f, 1.0f) : 0.0f;
+    uint64_t bucket = uint64_t(normalized * depthMax);
+    if (translucent) bucket = depthMax - bucket;
+
+    return (uint64_t(pass & 0xF) << 60)
+         | (uint64_t(translucent ? 1 : 0) << 59)
+         | (uint64_t(shader & 0x3FF) << 49)
+         | (uint64_t(material & 0xFFFFFF) << 25)
+         | bucket;
+}
+
+void RenderQueue::sort()
+{
+    sortPasses = 0;
+    if (items.size() < 2) return;
+
+    scratch.resize(items.size());
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        std::array<size_t, 256> counts = {};
+        for (const Item& item : items)
+            counts[(item.key >> shift) & 0xFF]++;
+
+        // Every key has the same byte here, the order would not change
+        if (counts[(items[0].key >> shift) & 0xFF] == items.size()) continue;
+
+        size_t offset = 0;
+        for (size_t& count : counts) {
+            size_t bucket = count;
+            count = offset;
+            offset += bucket;
+        }
+
+        for (const Item& item : items)
+            scratch[counts[(item.key >> shift) & 0xFF]++] = item;
+
+        items.swap(scratch);
+        sortPasses++;
+    }
+}
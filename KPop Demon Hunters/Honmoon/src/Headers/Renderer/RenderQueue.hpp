@@ -0,0 +1,39 @@
+#pragma once
+// Other
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Draws as 64-bit sort keys plus a payload (an index into whatever list the caller keeps),
+// radix sorted so the replay binds each program, material and mesh as few times as possible.
+// Key, most significant bits first:
+//   pass 4 | translucent 1 | shader 10 | material 24 | depth bucket 25
+// Opaque items sort front to back inside a material, translucent ones back to front.
+class RenderQueue {
+public:
+    struct Item {
+        uint64_t key;
+        uint32_t payload;
+    };
+
+    static constexpr int depthBits = 25;
+
+    // depth is clamped to [0, maxDepth], the key keeps the low bits of pass, shader and material
+    static uint64_t MakeKey(unsigned int pass, bool translucent, unsigned int shader, unsigned int material, float depth, float maxDepth);
+
+public:
+    void clear() { items.clear(); }
+    void push(uint64_t key, uint32_t payload) { items.push_back({ key, payload }); }
+
+    // Stable LSD radix sort, 8 bits per pass, skipping the bytes every key shares
+    void sort();
+
+    const std::vector<Item>& getItems() const { return items; }
+    size_t size() const { return items.size(); }
+    int getLastSortPasses() const { return sortPasses; }
+
+private:
+    std::vector<Item> items;
+    std::vector<Item> scratch;
+    int sortPasses = 0;
+};
@@ -0,0 +1,44 @@
+#include "WeightedOIT.hpp"
+#include "GLState.hpp"
+
+WeightedOIT::WeightedOIT(Shader& resolveShader, unsigned int quadVAO)
+    : resolveShader(resolveShader), quadVAO(quadVAO)
+{
+}
+
+void WeightedOIT::begin()
+{
+    const GLfloat noColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const GLfloat revealed[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, noColor);
+    glClearBufferfv(GL_COLOR, 1, revealed);
+
+    // Sums and products, neither cares about the order
+    GLState::DepthMask(GL_FALSE);
+    GLState::BlendFunci(0, GL_ONE, GL_ONE);
+    GLState::BlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+void WeightedOIT::resolve(unsigned int accumulation, unsigned int revealage)
+{
+    GLState::Disable(GL_DEPTH_TEST);
+    GLState::BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    resolveShader.use();
+    resolveShader.setInt("accumulation", 0);
+    resolveShader.setInt("revealage", 1);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BindTexture(GL_TEXTURE_2D, accumulation);
+    GLState::ActiveTexture(GL_TEXTURE1);
+    GLState::BindTexture(GL_TEXTURE_2D, revealage);
+
+    GLState::BindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    GLState::BindVertexArray(0);
+
+    GLState::ActiveTexture(GL_TEXTURE0);
+    GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::Enable(GL_DEPTH_TEST);
+    GLState::DepthMask(GL_TRUE);
+}
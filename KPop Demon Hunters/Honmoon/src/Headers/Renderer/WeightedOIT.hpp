@@ -0,0 +1,36 @@
+#pragma once
+// OpenGL
+#include <glad/glad.h>
+// My headers
+#include "../Shaders/Shader.hpp"
+
+// Weighted blended order independent transparency (McGuire and Bavoil 2013).
+// Translucent surfaces add their premultiplied color, weighted by alpha and depth, into an accumulation
+// target and multiply a revealage target by (1 - alpha), both with commutative blending, so draw order
+// does not matter. The resolve divides out the weights and covers what the layers cover together.
+// Shaders write the accumulation to location 0 and the revealage to location 1 (see Honmoon.frag).
+// Owns no textures: both targets are transients sized like the color the Honmoon draws into, and
+// only live from the Honmoon pass to the resolve, so the graph can reuse their memory afterwards.
+class WeightedOIT {
+public:
+    static constexpr GLenum AccumulationFormat = GL_RGBA16F;
+    static constexpr GLenum RevealageFormat = GL_R8;
+
+public:
+    WeightedOIT(Shader& resolveShader, unsigned int quadVAO);
+
+    WeightedOIT(const WeightedOIT&) = delete;
+    WeightedOIT& operator=(const WeightedOIT&) = delete;
+
+    // Clears the bound targets, accumulation at location 0 and revealage at 1.
+    // The bound depth is tested but never written.
+    void begin();
+
+    // Blends the resolved layers, premultiplied, into the bound framebuffer.
+    // Restores the default blending and depth writes.
+    void resolve(unsigned int accumulation, unsigned int revealage);
+
+private:
+    Shader& resolveShader;
+    unsigned int quadVAO;
+};
@@ -1,4 +1,41 @@
 #include "Shader.hpp"
+#include "../Renderer/GLState.hpp"
+
+// Splices #include "file" lines, the file relative to the including one, so shaders can share code
+static std::string ResolveIncludes(const std::string& code, const std::string& path, int depth = 0)
+{
+    if (depth > 8) {
+        std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP: " << path << std::endl;
+        return code;
+    }
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+    std::stringstream in(code);
+    std::string result, line;
+    while (std::getline(in, line)) {
+        size_t directive = line.find_first_not_of(" \t");
+        size_t open = line.find('"');
+        size_t close = line.find('"', open + 1);
+        if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0 || open == std::string::npos || close == std::string::npos) {
+            result += line + "\n";
+            continue;
+        }
+
+        std::string includePath = directory + line.substr(open + 1, close - open - 1);
+        std::ifstream file(includePath);
+        if (!file) {
+            std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+            continue;
+        }
+
+        std::stringstream included;
+        included << file.rdbuf();
+        result += ResolveIncludes(included.str(), includePath, depth + 1);
+    }
+
+    return result;
+}
 
 Shader::Shader(std::string vertexSrc, std::string fragmentSrc, std::string geometrySrc, bool isFromFile)
 {
@@ -26,8 +63,8 @@ Shader::Shader(std::string vertexSrc, std::string fragmentSrc, std::string geome
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            vertexCode = ResolveIncludes(vShaderStream.str(), vertexSrc);
+            fragmentCode = ResolveIncludes(fShaderStream.str(), fragmentSrc);
             // if geometry shader path is present, also load a geometry shader
             if (geometrySrc != "")
             {
@@ -35,7 +72,7 @@ Shader::Shader(std::string vertexSrc, std::string fragmentSrc, std::string geome
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                geometryCode = ResolveIncludes(gShaderStream.str(), geometrySrc);
             }
         }
         catch (std::ifstream::failure& e)
@@ -84,7 +121,7 @@ Shader::Shader(std::string vertexSrc, std::string fragmentSrc, std::string geome
 
 void Shader::use()
 {
-    glUseProgram(ID);
+    GLState::UseProgram(ID);
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -128,7 +165,7 @@ ComputeShader::ComputeShader(std::string src, bool isFromFile)
             // close file handlers
             ShaderFile.close();
             // convert stream into string
-            shaderCode = vShaderStream.str();
+            shaderCode = ResolveIncludes(vShaderStream.str(), src);
         }
         catch (std::ifstream::failure& e)
         {
@@ -150,7 +187,7 @@ ComputeShader::ComputeShader(std::string src, bool isFromFile)
 
 void ComputeShader::use()
 {
-    glUseProgram(ID);
+    GLState::UseProgram(ID);
 }
 
 void ComputeShader::checkCompileErrors(unsigned int shader, std::string type)
@@ -3,6 +3,7 @@
 #define TEXURE_H
 
 #include <glad/glad.h>
+#include "../Renderer/GLState.hpp"
 #include <stb_image.h>
 #include <iostream>
 #include <unordered_map>
@@ -45,7 +46,7 @@ inline unsigned int TextureFromMemory(const unsigned char* data, size_t size) {
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    GLState::BindTexture(GL_TEXTURE_2D, textureID);
 
     glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
         format, GL_UNSIGNED_BYTE, image);
@@ -72,7 +73,7 @@ inline unsigned int TextureFromRawPixels(aiTexel* pixels, int width, int height)
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    GLState::BindTexture(GL_TEXTURE_2D, textureID);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
         GL_RGBA, GL_UNSIGNED_BYTE, data.data());
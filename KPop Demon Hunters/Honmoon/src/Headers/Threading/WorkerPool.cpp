@@ -0,0 +1,83 @@
+#include "WorkerPool.hpp"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int threadCount)
+{
+    if (threadCount == 0) threadCount = 1;
+
+    for (unsigned int i = 1; i < threadCount; i++)
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void WorkerPool::parallelFor(size_t count, const Job& job)
+{
+    if (count == 0) return;
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+
+    unsigned int chunks = static_cast<unsigned int>(std::min<size_t>(size(), count));
+    if (chunks == 1) {
+        job(0, count, 0);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    this->job = &job;
+    jobCount = count;
+    jobChunks = chunks;
+    nextChunk = 0;
+    pendingChunks = chunks;
+    generation++;
+    wakeCondition.notify_all();
+
+    while (runNextChunk(lock));
+
+    doneCondition.wait(lock, [this] { return pendingChunks == 0; });
+    this->job = nullptr;
+}
+
+void WorkerPool::workerLoop()
+{
+    unsigned long long seenGeneration = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeCondition.wait(lock, [&] { return stop || generation != seenGeneration; });
+        if (stop) return;
+
+        seenGeneration = generation;
+        while (runNextChunk(lock));
+    }
+}
+
+// Called with the lock held, releases it while the chunk runs
+bool WorkerPool::runNextChunk(std::unique_lock<std::mutex>& lock)
+{
+    if (job == nullptr || nextChunk >= jobChunks) return false;
+
+    unsigned int chunk = nextChunk++;
+    size_t begin = jobCount * chunk / jobChunks;
+    size_t end = jobCount * (chunk + 1) / jobChunks;
+    const Job* current = job;
+
+    lock.unlock();
+    (*current)(begin, end, chunk);
+    lock.lock();
+
+    if (--pendingChunks == 0)
+        doneCondition.notify_all();
+
+    return true;
+}
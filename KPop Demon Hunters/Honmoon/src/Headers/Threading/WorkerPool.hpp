@@ -0,0 +1,47 @@
+#pragma once
+// Other
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// Fixed set of worker threads that split a range of work into chunks.
+// The calling thread works on the first chunk itself, so size() counts it too.
+class WorkerPool {
+public:
+    // begin and end delimit the chunk, chunk is in [0, size())
+    using Job = std::function<void(size_t begin, size_t end, unsigned int chunk)>;
+
+public:
+    explicit WorkerPool(unsigned int threadCount = std::thread::hardware_concurrency());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned int size() const { return static_cast<unsigned int>(threads.size()) + 1; }
+
+    // Blocks until every chunk of [0, count) has run. Calls from several threads are serialized.
+    void parallelFor(size_t count, const Job& job);
+
+private:
+    void workerLoop();
+    bool runNextChunk(std::unique_lock<std::mutex>& lock);
+
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    const Job* job = nullptr;
+    size_t jobCount = 0;
+    unsigned int jobChunks = 0;
+    unsigned int nextChunk = 0;
+    unsigned int pendingChunks = 0;
+    unsigned long long generation = 0;
+    bool stop = false;
+};
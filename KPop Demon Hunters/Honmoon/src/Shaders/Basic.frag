@@ -1,9 +1,6 @@
 #version 450 core
-layout (location = 2) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout(location = 0) out vec4 gColor;
-
-//out vec4 FragColor;
+// Forward path, the deferred one writes GBuffer.frag's outputs instead
+out vec4 FragColor;
 
 in vec3 FragPos; 
 in vec2 TexCoords;
@@ -30,6 +27,9 @@ uniform DirLight dirLight;
 uniform Material material;
 uniform vec3 viewPos;
 
+// Point lights of this fragment's cluster only
+#include "LightClusters.glsl"
+
 vec3 calculateDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 color, vec3 specMap, float shininess) {
     light.ambient *= light.color;
     light.diffuse *= light.color;
@@ -63,7 +63,11 @@ void main() {
 
     vec3 lighting = calculateDirLight(dirLight, normal, viewDir, Albedo, SpecularMap, 33.0);
 
-    gPosition = FragPos;
-    gNormal = normal;
-    gColor = vec4(lighting, 1.0);
+    if (useClusteredLights) {
+        uvec2 cluster = findCluster(gl_FragCoord.xy, -(view * vec4(FragPos, 1.0)).z);
+        lighting += calculatePointLights(cluster, FragPos, normal, viewDir, Albedo, SpecularMap, 33.0);
+        if (showLightDensity) lighting = mix(lighting, lightDensityColor(cluster.y), 0.5);
+    }
+
+    FragColor = vec4(lighting, 1.0);
 }
@@ -14,6 +14,9 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Same depth as DepthPrepass.vert, so the shading pass can test with GL_EQUAL after a pre-pass
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
@@ -0,0 +1,45 @@
+#version 330 core
+
+in vec2 TexCoords;
+out vec4 FragColor;
+
+uniform sampler2D sceneDepth;   // full resolution
+uniform sampler2D lowDepth;     // what the low resolution pass was depth tested against
+uniform sampler2D lowColor;     // premultiplied
+
+uniform vec2 depthParams;       // projection[2][2], projection[3][2]
+
+float linearDepth(float depth)
+{
+    return depthParams.y / (depth * 2.0 - 1.0 + depthParams.x);
+}
+
+// Bilinear weights of the four nearest low resolution texels, scaled down by how far their depth
+// is from this pixel's, so a texel across an edge contributes next to nothing
+void main()
+{
+    float depth = linearDepth(texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r);
+
+    ivec2 lowSize = textureSize(lowColor, 0);
+    vec2 p = TexCoords * vec2(lowSize) - 0.5;
+    vec2 base = floor(p);
+    vec2 f = p - base;
+
+    vec4 color = vec4(0.0);
+    float total = 0.0;
+
+    for (int y = 0; y <= 1; y++) {
+        for (int x = 0; x <= 1; x++) {
+            ivec2 texel = clamp(ivec2(base) + ivec2(x, y), ivec2(0), lowSize - 1);
+
+            float bilinear = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+            float difference = abs(depth - linearDepth(texelFetch(lowDepth, texel, 0).r)) / depth;
+            float weight = (bilinear + 1e-3) / (difference + 1e-3);
+
+            color += texelFetch(lowColor, texel, 0) * weight;
+            total += weight;
+        }
+    }
+
+    FragColor = color / total;
+}
@@ -0,0 +1,87 @@
+#version 430 core
+
+out vec4 FragColor;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 color;
+};
+
+uniform DirLight dirLight;
+uniform vec3 viewPos;
+uniform mat4 inverseViewProjection;
+
+// Point lights of this fragment's cluster only
+#include "LightClusters.glsl"
+
+// Inverse of encodeNormal in GBuffer.frag
+vec3 decodeNormal(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+// Same lighting as Basic.frag, the shininess comes from the packed roughness
+vec3 calculateDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 color, float specMap, float shininess) {
+    light.ambient *= light.color;
+    light.diffuse *= light.color;
+    light.specular *= light.color;
+
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+
+    vec3 ambient = light.ambient * color;
+    vec3 diffuse = light.diffuse * diff * color;
+    vec3 specular = light.specular * spec * specMap;
+
+    return ambient + diffuse + specular;
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+
+    // Keeps the scene depth for the forward passes drawn after this one
+    float depth = texelFetch(gDepth, p, 0).r;
+    gl_FragDepth = depth;
+
+    if (depth >= 1.0) {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);   // clear color
+        return;
+    }
+
+    // World position from the depth alone
+    vec2 ndc = (vec2(p) + 0.5) / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec3 FragPos = world.xyz / world.w;
+
+    vec4 albedo = texelFetch(gAlbedo, p, 0);
+    vec3 normal = decodeNormal(texelFetch(gNormal, p, 0).rg);
+
+    float packed = floor(albedo.a * 255.0 + 0.5);
+    float rough = floor(packed / 16.0) / 15.0;
+    float specular = mod(packed, 16.0) / 15.0;
+    float shininess = exp2(10.0 * (1.0 - rough));
+
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 lighting = calculateDirLight(dirLight, normal, viewDir, albedo.rgb, specular, shininess);
+
+    if (useClusteredLights) {
+        uvec2 cluster = findCluster(gl_FragCoord.xy, -(view * vec4(FragPos, 1.0)).z);
+        lighting += calculatePointLights(cluster, FragPos, normal, viewDir, albedo.rgb, vec3(specular), shininess);
+        if (showLightDensity) lighting = mix(lighting, lightDensityColor(cluster.y), 0.5);
+    }
+
+    FragColor = vec4(lighting, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+uniform sampler2D sceneDepth;
+uniform int divisor;            // full resolution texels per low resolution texel, per side
+
+// Nearest depth of the block: the Honmoon is only drawn where no part of the block hides it,
+// and the upsampling fills the edges from neighbours at the right depth
+void main()
+{
+    ivec2 base = ivec2(gl_FragCoord.xy) * divisor;
+    ivec2 last = textureSize(sceneDepth, 0) - 1;
+
+    float depth = 1.0;
+    for (int y = 0; y < divisor; y++)
+        for (int x = 0; x < divisor; x++)
+            depth = min(depth, texelFetch(sceneDepth, min(base + ivec2(x, y), last), 0).r);
+
+    gl_FragDepth = depth;
+}
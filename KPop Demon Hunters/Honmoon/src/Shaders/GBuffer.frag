@@ -0,0 +1,49 @@
+#version 450 core
+layout(location = 0) out vec4 gAlbedo;     // rgb albedo, a roughness and specular, 4 bits each
+layout(location = 1) out vec2 gNormal;     // octahedral world normal
+
+in vec3 FragPos;
+in vec2 TexCoords;
+in mat3 TBN;  // from vertex shader
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_normal1;
+    sampler2D texture_specular1;
+    sampler2D texture_roughness1;
+    sampler2D texture_metallic1;
+    sampler2D texture_ao1;
+};
+
+uniform Material material;
+uniform float roughness;    // the meshes have no reliable roughness maps, see GBuffer::DefaultRoughness
+
+// Unit vector folded onto the octahedron, then its lower half unfolded over the corners
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+float packMaterial(float rough, float spec) {
+    float high = floor(clamp(rough, 0.0, 1.0) * 15.0 + 0.5);
+    float low = floor(clamp(spec, 0.0, 1.0) * 15.0 + 0.5);
+    return (high * 16.0 + low) / 255.0;
+}
+
+void main() {
+    vec3 Albedo = texture(material.texture_diffuse1, TexCoords).rgb;
+
+    // Normal map (tangent space -> world space)
+    vec3 normal = texture(material.texture_normal1, TexCoords).rgb;
+    normal = normalize(normal * 2.0 - 1.0);
+    normal = normalize(TBN * normal);
+
+    // Basic.frag tints the highlight with the map, a single intensity is close enough
+    vec3 SpecularMap = texture(material.texture_specular1, TexCoords).rgb;
+    float specular = dot(SpecularMap, vec3(1.0 / 3.0));
+
+    gAlbedo = vec4(Albedo, packMaterial(roughness, specular));
+    gNormal = encodeNormal(normal);
+}
@@ -1,26 +1,157 @@
 #version 430 core
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out float Revealage;   // weighted blended mode only, see WeightedOIT
 
 in vec3 position;
+flat in int barrier;         // -1 for the main Honmoon, otherwise its index in barriers
 uniform vec2 patternOrigin;  // center of concentric pattern
 uniform float spacing;       // distance between rings
 uniform float thickness;     // how thick each ring is
 uniform vec4 color1;         // ring color
 uniform vec4 color2;         // background color
+uniform float progress;      // fraction of the area the sweep has reached, 1 shows everything
+
+uniform vec3 origin;
+uniform vec3 size;
+
+// Writes weighted accumulation and revealage instead of a blended color
+uniform bool weightedBlended;
+
+// Distance over the surface from the pattern origin (see GeodesicField)
+uniform bool useGeodesic;
+uniform sampler2D geodesicField;
+layout(std430, binding = 1) readonly buffer GeodesicRange {
+    uint maxDistanceBits;
+};
+
+// Matches HonmoonBarriers::GpuBarrier
+struct Barrier {
+    vec4 positionHover;
+    vec4 sizeThickness;
+    vec4 pattern;
+    vec4 color1;
+    vec4 color2;
+    vec4 atlasRect;
+};
+
+layout(std430, binding = 2) readonly buffer Barriers {
+    Barrier barriers[];
+};
+
+// Impact ripples, only the ones binned into this point's world tile (see RippleEvents)
+uniform bool useRipples;
+uniform float time;
+uniform vec4 rippleParams;      // speed, wavelength, lifetime, amplitude
+uniform vec4 rippleArea;        // min.xz, size.xz of the tile grid
+uniform int rippleTiles;        // tiles per side
+
+const int maxRipplesPerTile = 64;   // RippleEvents::maxEventsPerTile
+
+layout(std430, binding = 3) readonly buffer RippleEventBuffer {
+    vec4 rippleEvents[];        // x, z origin, start time, strength
+};
+layout(std430, binding = 4) readonly buffer RippleTileCounts {
+    uint rippleTileCounts[];
+};
+layout(std430, binding = 5) readonly buffer RippleTileLists {
+    uint rippleTileLists[];
+};
+
+// Sum of the wave packets crossing p, about -1 to 1 per event
+float rippleWave(vec2 p){
+    vec2 cell = (p - rippleArea.xy) / rippleArea.zw * float(rippleTiles);
+    if (any(lessThan(cell, vec2(0.0))) || any(greaterThanEqual(cell, vec2(rippleTiles)))) return 0.0;
+
+    int tile = int(cell.y) * rippleTiles + int(cell.x);
+    int count = min(int(rippleTileCounts[tile]), maxRipplesPerTile);
+
+    float wave = 0.0;
+    for (int i = 0; i < count; i++) {
+        vec4 event = rippleEvents[rippleTileLists[tile * maxRipplesPerTile + i]];
+        float age = time - event.z;
+
+        // Distance behind the front in wavelengths, the packet fades out over the lifetime
+        float x = (distance(p, event.xy) - rippleParams.x * age) / rippleParams.y;
+        float fade = 1.0 - age / rippleParams.z;
+        wave += event.w * fade * exp(-4.0 * x * x) * cos(6.2831853 * x);
+    }
+
+    return wave;
+}
+
+// Farthest corner of an area from the pattern origin
+float cornerDistance(vec3 areaOrigin, vec3 areaSize, vec2 center)
+{
+    vec2 nearCorner = abs(areaOrigin.xz - center);
+    vec2 farCorner = abs(areaOrigin.xz + areaSize.xz - center);
+    return length(max(nearCorner, farCorner));
+}
 
 void main()
 {
-    // distance from fragment to the origin
-    float dist = length(position.xz - patternOrigin);
+    vec2 center = patternOrigin;
+    float ringSpacing = spacing;
+    float ringThickness = thickness;
+    float sweep = progress;
+    vec4 ringColor = color1;
+    vec4 background = color2;
+
+    float dist;
+    float maxDist;
+
+    if (barrier >= 0) {
+        // Barriers keep everything in their own parameters, and measure rings on the flat
+        Barrier params = barriers[barrier];
+        center = params.pattern.xy;
+        ringSpacing = params.pattern.z;
+        ringThickness = params.sizeThickness.w;
+        sweep = params.pattern.w;
+        ringColor = params.color1;
+        background = params.color2;
 
-    
+        dist = length(position.xz - center);
+        maxDist = cornerDistance(params.positionHover.xyz, params.sizeThickness.xyz, center);
+    }
+    else if (useGeodesic) {
+        vec2 uv = (position.xz - origin.xz) / size.xz;
+        uv.y = 1.0 - uv.y;             // flip
+
+        dist = texture(geodesicField, uv).r;
+        maxDist = uintBitsToFloat(maxDistanceBits);
+    }
+    else {
+        // distance from fragment to the origin
+        dist = length(position.xz - center);
+        maxDist = cornerDistance(origin, size, center);
+    }
 
     // create thin ring shape within the spacing
-    float modDist = mod(dist, spacing);
-    float ringMask = smoothstep(0.0, thickness, modDist) 
-                   * (1.0 - smoothstep(thickness, thickness * 1.2, modDist));
+    float modDist = mod(dist, ringSpacing);
+    float ringMask = smoothstep(0.0, ringThickness, modDist) 
+                   * (1.0 - smoothstep(ringThickness, ringThickness * 1.2, modDist));
+
+    // Crests light up like rings
+    if (useRipples) ringMask = max(ringMask, smoothstep(0.4, 1.0, rippleWave(position.xz)));
+
+    // Sweep outwards from the origin, with a solid front one ring wide
+    if (sweep < 1.0) {
+        float sweepRadius = sweep * maxDist;
+        if (dist > sweepRadius) discard;
+
+        ringMask = max(ringMask, 1.0 - smoothstep(0.0, ringSpacing, sweepRadius - dist));
+    }
 
     // mix background and ring color
-    FragColor = mix(color2, color1, ringMask);
+    vec4 color = mix(background, ringColor, ringMask);
+
+    if (weightedBlended) {
+        // McGuire and Bavoil's depth weight, nearer layers dominate the average
+        float weight = color.a * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0));
+        FragColor = vec4(color.rgb * color.a, color.a) * weight;
+        Revealage = color.a;
+        return;
+    }
+
+    FragColor = color;
 }
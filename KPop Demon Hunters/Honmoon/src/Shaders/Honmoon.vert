@@ -1,66 +1,223 @@
-#version 330 core
+#version 430 core
 layout(location = 0) in vec2 aTexCoords;
+layout(location = 1) in vec4 aPatch;    // quadtree: xy offset, z scale (texture space), w level
 
 uniform mat4 view;
 uniform mat4 projection;
 
 uniform float hoverHeight;
-uniform float yCamOffset;
 uniform vec3 origin;
 uniform vec3 size;
+uniform vec3 cameraPosition;
+
+// 0: buffered grid, 1: procedural grid (see HonmoonGrid), 2: quadtree patches (see HonmoonQuadtree),
+// 3: one instance per barrier over a shared procedural grid (see HonmoonBarriers)
+uniform int gridMode;
+uniform vec2 gridSize;      // cells per side
+uniform float heightLod;    // mip whose texels match one grid cell
+
+uniform int patchSize;              // cells per side of one quadtree patch
+uniform vec2 morphRanges[12];       // distance where each level starts and ends morphing into the next
+
+// r: world height, g/b: normal x/z, a: curvature (see HeightField.comp)
+uniform sampler2D heightField;
+
+// Finer depth around the camera where available (see HeightClipmap), map space is (x, -z)
+uniform bool useClipmap;
+uniform int clipmapLevelCount;
+uniform vec4 clipmapRects[4];       // resident part of each level, min.xy max.zw in map space
+uniform float clipmapTexelSize[4];
+uniform float clipmapResolution;
+uniform float clipmapCameraHeight;
+uniform sampler2DArray heightClipmap;
+
+const float clipmapNear = 0.1;      // HeightMap::nearPlane
+const float clipmapFar = 100.0;     // HeightMap::farPlane
+
+// Matches HonmoonBarriers::GpuBarrier
+struct Barrier {
+    vec4 positionHover;     // xyz corner, w hover height
+    vec4 sizeThickness;     // xyz size, w ring thickness
+    vec4 pattern;           // xy ring origin (x, z), z spacing, w progress
+    vec4 color1;
+    vec4 color2;
+    vec4 atlasRect;         // region of the height field under the barrier, uv min.xy max.zw
+};
+
+layout(std430, binding = 2) readonly buffer Barriers {
+    Barrier barriers[];
+};
+
+// Impact ripples, only the ones binned into this point's world tile (see RippleEvents)
+uniform bool useRipples;
+uniform float time;
+uniform vec4 rippleParams;      // speed, wavelength, lifetime, amplitude
+uniform vec4 rippleArea;        // min.xz, size.xz of the tile grid
+uniform int rippleTiles;        // tiles per side
+
+const int maxRipplesPerTile = 64;   // RippleEvents::maxEventsPerTile
+
+layout(std430, binding = 3) readonly buffer RippleEventBuffer {
+    vec4 rippleEvents[];        // x, z origin, start time, strength
+};
+layout(std430, binding = 4) readonly buffer RippleTileCounts {
+    uint rippleTileCounts[];
+};
+layout(std430, binding = 5) readonly buffer RippleTileLists {
+    uint rippleTileLists[];
+};
 
-uniform float near;
-uniform float far;
+out vec3 position;
+flat out int barrier;       // -1 for the main Honmoon
 
-uniform sampler2D terrrainHeight;
+// Same quads and winding as the buffered index list: row = instance, 6 vertices per quad
+const ivec2 quadCorners[6] = ivec2[6](
+    ivec2(0, 0), ivec2(0, 1), ivec2(1, 0),
+    ivec2(1, 0), ivec2(0, 1), ivec2(1, 1)
+);
 
-out vec3 position;
+float getHeightLod(){
+    if (gridMode != 2) return heightLod;
+
+    float texelsPerCell = textureSize(heightField, 0).x * aPatch.z / float(patchSize);
+    return max(log2(texelsPerCell), 0.0);
+}
+
+float clipmapHeight(vec2 uv, int level){
+    float depth = textureLod(heightClipmap, vec3(uv, level), 0.0).r;
+    return clipmapCameraHeight - (depth * (clipmapFar - clipmapNear) + clipmapNear);
+}
+
+// Same layout as the height field texel, from the finest level covering the point
+bool sampleClipmap(vec2 map, inout vec4 field){
+    for (int level = 0; level < clipmapLevelCount; level++) {
+        float texel = clipmapTexelSize[level];
+        vec4 rect = clipmapRects[level] + vec4(texel, texel, -texel, -texel);
+        if (any(lessThan(map, rect.xy)) || any(greaterThan(map, rect.zw))) continue;
+
+        // Wrapping does the toroidal addressing
+        vec2 uv = map / (texel * clipmapResolution);
+        float texelStep = 1.0 / clipmapResolution;
+
+        float H0 = clipmapHeight(uv, level);
+        float Hx = clipmapHeight(uv + vec2(texelStep, 0.0), level);
+        float Hz = clipmapHeight(uv + vec2(0.0, texelStep), level);
+
+        // Map y grows towards -z, like the height map texels
+        vec3 normal = normalize(vec3(-(Hx - H0) / texel, 1.0, (Hz - H0) / texel));
+
+        field = vec4(H0, normal.x, normal.z, field.a);
+        return true;
+    }
+
+    return false;
+}
+
+// Sum of the wave packets crossing p, about -1 to 1 per event
+float rippleWave(vec2 p){
+    vec2 cell = (p - rippleArea.xy) / rippleArea.zw * float(rippleTiles);
+    if (any(lessThan(cell, vec2(0.0))) || any(greaterThanEqual(cell, vec2(rippleTiles)))) return 0.0;
+
+    int tile = int(cell.y) * rippleTiles + int(cell.x);
+    int count = min(int(rippleTileCounts[tile]), maxRipplesPerTile);
+
+    float wave = 0.0;
+    for (int i = 0; i < count; i++) {
+        vec4 event = rippleEvents[rippleTileLists[tile * maxRipplesPerTile + i]];
+        float age = time - event.z;
+
+        // Distance behind the front in wavelengths, the packet fades out over the lifetime
+        float x = (distance(p, event.xy) - rippleParams.x * age) / rippleParams.y;
+        float fade = 1.0 - age / rippleParams.z;
+        wave += event.w * fade * exp(-4.0 * x * x) * cos(6.2831853 * x);
+    }
+
+    return wave;
+}
+
+vec2 getPatchTexCoords(){
+    int quad = gl_VertexID / 6;
+    vec2 gridPos = vec2(ivec2(quad % patchSize, quad / patchSize) + quadCorners[gl_VertexID % 6]);
+    vec2 texCoords = aPatch.xy + gridPos / float(patchSize) * aPatch.z;
+
+    // Odd vertices slide onto their even neighbours as the distance reaches the end of the level
+    float height = textureLod(heightField, vec2(texCoords.x, 1.0 - texCoords.y), getHeightLod()).r;
+    vec3 worldPos = origin + size * vec3(texCoords.x, 0.0, texCoords.y);
+    worldPos.y = height;
+
+    vec2 morph = morphRanges[int(aPatch.w)];
+    float k = clamp((distance(worldPos, cameraPosition) - morph.x) / (morph.y - morph.x), 0.0, 1.0);
+
+    gridPos -= fract(gridPos * 0.5) * 2.0 * k;
+    return aPatch.xy + gridPos / float(patchSize) * aPatch.z;
+}
+
+vec2 getTexCoords(){
+    if (gridMode == 0) return aTexCoords;
+    if (gridMode == 2) return getPatchTexCoords();
+
+    if (gridMode == 3) {
+        // The instance is the barrier, so the whole grid comes from the vertex index
+        int quadsPerRow = int(gridSize.x) - 1;
+        int quad = gl_VertexID / 6;
+        ivec2 cell = ivec2(quad % quadsPerRow, quad / quadsPerRow) + quadCorners[gl_VertexID % 6];
+        return vec2(cell) / gridSize;
+    }
+
+    ivec2 cell = ivec2(gl_VertexID / 6, gl_InstanceID) + quadCorners[gl_VertexID % 6];
+    return vec2(cell) / gridSize;
+}
 
 vec3 getWorldPosition(){
-    vec3 worldPos = origin + size * vec3(aTexCoords.x, 0.0, aTexCoords.y);
+    vec2 texCoords = getTexCoords();
+
+    vec3 areaOrigin = origin;
+    vec3 areaSize = size;
+    float hover = hoverHeight;
+    vec2 uv = texCoords;
+    float lod = getHeightLod();
+
+    if (gridMode == 3) {
+        Barrier params = barriers[gl_InstanceID];
+        areaOrigin = params.positionHover.xyz;
+        areaSize = params.sizeThickness.xyz;
+        hover = params.positionHover.w;
+
+        // Only the part of the height field under this barrier
+        uv = mix(params.atlasRect.xy, params.atlasRect.zw, texCoords);
+        float texelsPerCell = textureSize(heightField, 0).x * (params.atlasRect.z - params.atlasRect.x) / gridSize.x;
+        lod = max(log2(texelsPerCell), 0.0);
+    }
+
+    vec3 worldPos = areaOrigin + areaSize * vec3(texCoords.x, 0.0, texCoords.y);
 
-    vec2 texSize = vec2(textureSize(terrrainHeight, 0));
-    vec2 texel = 1.0 / texSize;
+    vec2 cell = 1.0 / gridSize;
 
     // Skip edges entirely
-    if(aTexCoords.x <= texel.x || aTexCoords.x >= 1.0 - texel.x ||
-       aTexCoords.y <= texel.y || aTexCoords.y >= 1.0 - texel.y)
+    if(texCoords.x <= cell.x || texCoords.x >= 1.0 - cell.x ||
+       texCoords.y <= cell.y || texCoords.y >= 1.0 - cell.y)
     {
         gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
         return -vec3(1.0);
     }
 
-    vec2 uv = aTexCoords;
     uv.y = 1.0 - uv.y;             // flip
-    uv = clamp(uv + 0.5 * texel, texel, 1.0 - texel); // half-texel offset safely
-
-    // Tangent spacing in world units
-    float dx = size.x / texSize.x;
-    float dz = size.z / texSize.y;
-
-    float H0 = texture(terrrainHeight, uv).r * (far - near) + near;
-    float Hx = texture(terrrainHeight, uv + vec2(texel.x, 0)).r * (far - near) + near;
-    float Hz = texture(terrrainHeight, uv + vec2(0, texel.y)).r * (far - near) + near;
-
-    H0 = far - H0;
-    Hx = far - Hx;
-    Hz = far - Hz;
-
-    // Build tangent vectors with correct scale
-    vec3 tangentX = vec3(dx, Hx - H0, 0.0);
-    vec3 tangentZ = vec3(0.0, Hz - H0, dz);
 
-    vec3 normal = normalize(cross(tangentZ, tangentX));
+    // Filtered, so the grid no longer has to line up with the height map texels
+    vec4 field = textureLod(heightField, uv, lod);
+    if (useClipmap) sampleClipmap(vec2(worldPos.x, -worldPos.z), field);
+    vec3 normal = normalize(vec3(field.g, sqrt(max(1.0 - dot(field.gb, field.gb), 0.0)), field.b));
 
-    worldPos.y = H0;
-    worldPos += normal * hoverHeight;
-    worldPos.y -= yCamOffset;
+    worldPos.y = field.r;
+    worldPos += normal * hover;
+    if (useRipples) worldPos += normal * rippleParams.w * rippleWave(worldPos.xz);
 
     return worldPos;
 }
 
 void main()
 {
+    barrier = gridMode == 3 ? gl_InstanceID : -1;
     position = getWorldPosition();
 
     if (position == vec3(-1.0)) return;
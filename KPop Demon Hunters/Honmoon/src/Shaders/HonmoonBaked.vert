@@ -0,0 +1,23 @@
+#version 330 core
+layout(location = 0) in vec4 aPosition;    // w is 0 for skipped edge vertices
+layout(location = 1) in vec4 aNormal;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 position;
+flat out int barrier;       // never a barrier, see Honmoon.frag
+
+// Displacement already done by HonmoonBake.comp
+void main()
+{
+    position = aPosition.xyz;
+    barrier = -1;
+
+    if (aPosition.w == 0.0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    gl_Position = projection * view * vec4(position, 1.0);
+}
@@ -0,0 +1,61 @@
+// Clustered point lights shared by the forward (Basic.frag) and deferred (DeferredLighting.frag) paths,
+// spliced in by the Shader loader. The buffers are filled by LightClusters on the CPU.
+struct PointLight {
+    vec4 positionRadius;
+    vec4 colorIntensity;
+};
+
+layout(std430, binding = 6) readonly buffer PointLights {
+    PointLight pointLights[];
+};
+layout(std430, binding = 7) readonly buffer LightClusters {
+    uvec2 lightClusters[];      // offset into lightIndices, count
+};
+layout(std430, binding = 8) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+uniform bool useClusteredLights;
+uniform bool showLightDensity;
+uniform ivec3 clusterGrid;      // tiles x, tiles y, depth slices
+uniform vec2 clusterTileSize;   // pixels
+uniform vec2 clusterSlicing;    // slice = log(view depth) * x + y
+uniform mat4 view;
+
+uvec2 findCluster(vec2 fragCoord, float viewDepth) {
+    int slice = clamp(int(log(max(viewDepth, 1e-4)) * clusterSlicing.x + clusterSlicing.y), 0, clusterGrid.z - 1);
+    ivec2 tile = min(ivec2(fragCoord / clusterTileSize), clusterGrid.xy - 1);
+    return lightClusters[(slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+}
+
+vec3 calculatePointLights(uvec2 cluster, vec3 fragPos, vec3 normal, vec3 viewDir, vec3 color, vec3 specMap, float shininess) {
+    vec3 result = vec3(0.0);
+
+    for (uint i = 0u; i < cluster.y; i++) {
+        PointLight light = pointLights[lightIndices[cluster.x + i]];
+
+        vec3 toLight = light.positionRadius.xyz - fragPos;
+        float dist = length(toLight);
+        if (dist >= light.positionRadius.w) continue;
+
+        // Inverse square, windowed to reach zero at the radius
+        float window = clamp(1.0 - pow(dist / light.positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+
+        vec3 lightDir = toLight / max(dist, 1e-4);
+        float diff = max(dot(normal, lightDir), 0.0);
+        vec3 reflectDir = reflect(-lightDir, normal);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+
+        vec3 radiance = light.colorIntensity.rgb * light.colorIntensity.a * attenuation;
+        result += radiance * (diff * color + spec * specMap);
+    }
+
+    return result;
+}
+
+// Blue for no lights to red for 32 or more
+vec3 lightDensityColor(uint count) {
+    float t = clamp(float(count) / 32.0, 0.0, 1.0);
+    return vec3(t, 1.0 - abs(2.0 * t - 1.0), 1.0 - t);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D accumulation;     // weighted premultiplied color, weighted alpha
+uniform sampler2D revealage;        // product of (1 - alpha) of every layer
+
+// Weighted average of the layers, covering as much as all of them together do. Premultiplied output.
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+
+    float reveal = texelFetch(revealage, p, 0).r;
+    if (reveal >= 1.0) discard;
+
+    vec4 accum = texelFetch(accumulation, p, 0);
+    vec3 average = accum.rgb / max(accum.a, 1e-5);
+
+    FragColor = vec4(average * (1.0 - reveal), 1.0 - reveal);
+}
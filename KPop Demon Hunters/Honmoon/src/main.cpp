@@ -7,7 +7,12 @@
 #include "Headers/imgui/imgui_impl_opengl3.h"
 #include "Headers/imgui/implot.h"
 // Other
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
 #include <thread>
 #include <iostream>
 #include <filesystem>
@@ -17,6 +22,28 @@
 #include "Headers/IO/Input.hpp"
 #include "Headers/Camera.hpp"
 #include "Headers/Model.hpp"
+#include "Headers/Renderer/FrameQueue.hpp"
+#include "Headers/Renderer/CommandBuffer.hpp"
+#include "Headers/Renderer/GLState.hpp"
+#include "Headers/Renderer/AsyncReadback.hpp"
+#include "Headers/Renderer/LowResPass.hpp"
+#include "Headers/Renderer/WeightedOIT.hpp"
+#include "Headers/Renderer/GBuffer.hpp"
+#include "Headers/Renderer/LightClusters.hpp"
+#include "Headers/Renderer/GpuQuery.hpp"
+#include "Headers/Renderer/RenderQueue.hpp"
+#include "Headers/Renderer/RenderGraph.hpp"
+#include "Headers/Threading/WorkerPool.hpp"
+#include "Headers/Honmoon/HeightMap.hpp"
+#include "Headers/Honmoon/HeightField.hpp"
+#include "Headers/Honmoon/HeightClipmap.hpp"
+#include "Headers/Honmoon/CpuHeightMap.hpp"
+#include "Headers/Honmoon/HeightQuery.hpp"
+#include "Headers/Honmoon/GeodesicField.hpp"
+#include "Headers/Honmoon/HonmoonGrid.hpp"
+#include "Headers/Honmoon/HonmoonQuadtree.hpp"
+#include "Headers/Honmoon/HonmoonBarriers.hpp"
+#include "Headers/Honmoon/RippleEvents.hpp"
 
 using namespace IO;
 
@@ -50,20 +77,235 @@ glm::mat4 applyRotationQuat(glm::mat4 modelMatrix, const glm::vec3& rotation) {
 	return modelMatrix;
 }
 
-void DrawScene(Models& models, ModelIndex& indexes, ModelsProperties& properties, Shader& shader) {
+glm::mat4 GetModelMatrix(const ModelTransforms& transforms) {
+	glm::mat4 modelMatrix = glm::mat4(1.0f);
+
+	modelMatrix = glm::translate(modelMatrix, transforms.position);
+	modelMatrix = applyRotationQuat(modelMatrix, transforms.rotation);
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(transforms.scale));
+
+	return modelMatrix;
+}
+
+// Nearest first by the distance from the eye to each item's bounds, so the depth test rejects what is behind
+void SortFrontToBack(DrawList& drawList, const glm::vec3& eye) {
+	std::vector<std::pair<float, size_t>> keys;
+	keys.reserve(drawList.size());
+
+	for (size_t i = 0; i < drawList.size(); i++) {
+		const Bounds& bounds = drawList[i].worldBounds;
+		glm::vec3 offset = eye - glm::clamp(eye, bounds.min, bounds.max);
+		keys.push_back({ glm::dot(offset, offset), i });
+	}
+
+	std::sort(keys.begin(), keys.end());
+
+	DrawList sorted;
+	sorted.reserve(drawList.size());
+	for (const auto& key : keys)
+		sorted.push_back(drawList[key.second]);
+
+	drawList.swap(sorted);
+}
+
+void BuildDrawList(Models& models, ModelIndex& indexes, ModelsProperties& properties, DrawList& drawList) {
+	drawList.clear();
+
 	for (const auto& model_pair : indexes) {
 		size_t index = model_pair.second;
+		glm::mat4 modelMatrix = GetModelMatrix(properties[index]);
+		const std::vector<Mesh>& meshes = models[index].getMeshes();
+
+		for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+			drawList.push_back({ index, mesh, modelMatrix, TransformBounds(meshes[mesh].getBounds(), modelMatrix) });
+	}
+}
+
+// depthOnly draws positions only, for programs that read nothing but aPos and model
+void DrawScene(Models& models, const DrawList& drawList, Shader& shader, bool depthOnly = false) {
+	for (const DrawItem& item : drawList) {
+		shader.setMat4("model", item.modelMatrix);
+
+		Mesh& mesh = models[item.modelIndex].getMeshes()[item.meshIndex];
+		if (depthOnly) mesh.DrawDepth();
+		else mesh.Draw(shader);
+	}
+
+	GLState::BindVertexArray(0);
+	GLState::ActiveTexture(GL_TEXTURE0);
+}
+
+// Looks up every uniform the scene records, has to run on the context thread
+void ResolveSceneUniforms(const Models& models, const Shader& shader, UniformCache& uniforms, bool depthOnly = false) {
+	uniforms.resolve(shader.ID, "model");
+	if (depthOnly) return;
+
+	for (const Model& model : models)
+		for (const Mesh& mesh : model.getMeshes())
+			for (const std::string& sampler : mesh.getSamplerNames())
+				uniforms.resolve(shader.ID, sampler);
+}
+
+void RecordScene(const Models& models, const DrawList& drawList, size_t begin, size_t end, const UniformCache& uniforms, CommandBuffer& buffer, bool depthOnly) {
+	int modelLocation = uniforms.get("model");
+
+	for (size_t i = begin; i < end; i++) {
+		const DrawItem& item = drawList[i];
+
+		buffer.setMat4(modelLocation, item.modelMatrix);
+
+		const Mesh& mesh = models[item.modelIndex].getMeshes()[item.meshIndex];
+		if (depthOnly) mesh.RecordDepth(buffer);
+		else mesh.Record(buffer, uniforms);
+	}
+}
+
+// Each worker records a disjoint chunk of the draw list, the calling (context) thread replays them in order
+void RecordScene(const Models& models, const DrawList& drawList, const Shader& shader, const UniformCache& uniforms, WorkerPool& workers, std::vector<CommandBuffer>& buffers, bool depthOnly = false) {
+	for (CommandBuffer& buffer : buffers)
+		buffer.clear();
+
+	workers.parallelFor(drawList.size(), [&](size_t begin, size_t end, unsigned int chunk) {
+		buffers[chunk].bindProgram(shader.ID);
+		RecordScene(models, drawList, begin, end, uniforms, buffers[chunk], depthOnly);
+	});
+}
 
-		glm::mat4 modelMatrix = glm::mat4(1.0f);
-		
-		modelMatrix = glm::translate(modelMatrix, properties[index].position);
-		modelMatrix = applyRotationQuat(modelMatrix, properties[index].rotation);
-		modelMatrix = glm::scale(modelMatrix, glm::vec3(properties[index].scale));
+void ReplayScene(const std::vector<CommandBuffer>& buffers) {
+	for (const CommandBuffer& buffer : buffers)
+		ReplayCommandBuffer(buffer);
+}
+
+// Same, counting the bindings GLState let through and dropped across all the buffers
+void ReplayScene(const std::vector<CommandBuffer>& buffers, ReplayState& state) {
+	for (const CommandBuffer& buffer : buffers)
+		ReplayCommandBuffer(buffer, state);
+
+	GLState::BindVertexArray(0);
+	GLState::ActiveTexture(GL_TEXTURE0);
+}
+
+// Meshes with the same textures, in the same order, share a material id. Indexed [model][mesh].
+using MaterialTable = std::vector<std::vector<uint32_t>>;
 
-		shader.setMat4("model", modelMatrix);
+MaterialTable AssignMaterials(const Models& models) {
+	std::map<std::vector<unsigned int>, uint32_t> ids;
+	MaterialTable table;
 
-		models[index].Draw(shader);
+	for (const Model& model : models) {
+		std::vector<uint32_t>& meshes = table.emplace_back();
+		for (const Mesh& mesh : model.getMeshes()) {
+			std::vector<unsigned int> textures;
+			for (const Texture& texture : mesh.textures)
+				textures.push_back(texture.id);
+
+			auto id = ids.emplace(textures, uint32_t(ids.size())).first;
+			meshes.push_back(id->second);
+		}
 	}
+
+	return table;
+}
+
+// Submits meshCount meshes (cycling through the scene) both ways with rasterization off,
+// so the timings are dominated by CPU submission rather than fragment work
+SubmissionTiming BenchmarkSubmission(Models& models, Shader& shader, const UniformCache& uniforms, WorkerPool& workers, std::vector<CommandBuffer>& buffers, unsigned int meshCount) {
+	using clock = std::chrono::high_resolution_clock;
+
+	DrawList drawList;
+	drawList.reserve(meshCount);
+	while (drawList.size() < meshCount) {
+		for (size_t model = 0; model < models.size() && drawList.size() < meshCount; model++)
+			for (size_t mesh = 0; mesh < models[model].getMeshes().size() && drawList.size() < meshCount; mesh++)
+				drawList.push_back({ model, mesh, glm::mat4(1.0f), models[model].getMeshes()[mesh].getBounds() });
+
+		if (drawList.empty()) break;
+	}
+
+	SubmissionTiming timing;
+	timing.meshCount = meshCount;
+
+	GLState::Enable(GL_RASTERIZER_DISCARD);
+	shader.use();
+	glFinish();
+
+	auto start = clock::now();
+	DrawScene(models, drawList, shader);
+	glFinish();
+	timing.directMs = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+	start = clock::now();
+	RecordScene(models, drawList, shader, uniforms, workers, buffers);
+	timing.recordMs = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+	start = clock::now();
+	ReplayScene(buffers);
+	glFinish();
+	timing.replayMs = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+	GLState::Disable(GL_RASTERIZER_DISCARD);
+
+	return timing;
+}
+
+// Spreads count square barriers over the Honmoon area on a sunflower spiral, each with its own look
+std::shared_ptr<const BarrierList> ScatterBarriers(const HonmoonParams& area, int count, float size) {
+	auto barriers = std::make_shared<BarrierList>();
+	barriers->reserve(count);
+
+	size = std::min(size, std::min(area.size.x, area.size.z));
+	float radius = std::min(area.size.x, area.size.z) / 2.0f - size / 2.0f;
+
+	for (int i = 0; i < count; i++) {
+		float r = radius * std::sqrt((i + 0.5f) / count);
+		float angle = i * 2.39996323f;	// golden angle
+		glm::vec2 center = glm::vec2(area.center.x, area.center.z) + r * glm::vec2(std::cos(angle), std::sin(angle));
+
+		float variation = std::fmod(i * 0.61803399f, 1.0f);
+		glm::vec3 color(0.5f + 0.5f * std::cos(6.2831853f * variation),
+		                0.5f + 0.5f * std::cos(6.2831853f * (variation + 0.33f)),
+		                0.5f + 0.5f * std::cos(6.2831853f * (variation + 0.67f)));
+
+		HonmoonBarrier barrier;
+		barrier.position = glm::vec3(center.x - size / 2.0f, area.position.y, center.y - size / 2.0f);
+		barrier.size = glm::vec3(size, 0.0f, size);
+		barrier.patternOrigin = center;
+		barrier.hoverHeight = 0.1f + 0.4f * variation;
+		barrier.thickness = 0.05f + 0.1f * variation;
+		barrier.spacing = 0.3f + 0.4f * (1.0f - variation);
+		barrier.color1 = glm::vec4(color, 1.0f);
+		barrier.color2 = glm::vec4(color * 0.2f, 0.05f);
+
+		barriers->push_back(barrier);
+	}
+
+	return barriers;
+}
+
+// Lanterns on a sunflower spiral over the area, hovering height above its center
+std::shared_ptr<const PointLightList> ScatterLanterns(const HonmoonParams& area, int count, float radius, float height, float intensity) {
+	auto lights = std::make_shared<PointLightList>();
+	lights->reserve(count);
+
+	float spread = std::min(area.size.x, area.size.z) / 2.0f;
+
+	for (int i = 0; i < count; i++) {
+		float r = spread * std::sqrt((i + 0.5f) / count);
+		float angle = i * 2.39996323f;	// golden angle
+
+		// Warm colors, from deep orange to pale yellow
+		float variation = std::fmod(i * 0.61803399f, 1.0f);
+
+		PointLight light;
+		light.position = glm::vec3(area.center.x + r * std::cos(angle), area.center.y + height, area.center.z + r * std::sin(angle));
+		light.radius = radius;
+		light.color = glm::vec3(1.0f, 0.45f + 0.4f * variation, 0.15f + 0.35f * variation);
+		light.intensity = intensity;
+
+		lights->push_back(light);
+	}
+
+	return lights;
 }
 
 int main() {
@@ -96,12 +338,12 @@ int main() {
 
 	framebuffer_size_callback(window, SCR_WIDTH, SCR_HEIGHT);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::CullFace(GL_BACK);
 	glFrontFace(GL_CCW);
 #pragma endregion
 
@@ -121,6 +363,8 @@ int main() {
 
 	ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init("#version 130");
+	// Creates the font texture and device objects while this thread still owns the context
+	ImGui_ImplOpenGL3_NewFrame();
 #pragma endregion
 
 #pragma region Shader
@@ -130,7 +374,19 @@ int main() {
 
 	Shader heightShader(shaderPath + "Height.vert", shaderPath + "Height.frag");
 	Shader basicShader(shaderPath + "Basic.vert", shaderPath + "Basic.frag");
+	Shader gBufferShader(shaderPath + "Basic.vert", shaderPath + "GBuffer.frag");
+	Shader depthPrepassShader(shaderPath + "DepthPrepass.vert", shaderPath + "Height.frag");
+	Shader deferredLightingShader(shaderPath + "Fullscreen.vert", shaderPath + "DeferredLighting.frag");
 	Shader honmoonShader(shaderPath + "Honmoon.vert", shaderPath + "Honmoon.frag");
+	Shader honmoonBakedShader(shaderPath + "HonmoonBaked.vert", shaderPath + "Honmoon.frag");
+	ComputeShader heightFieldShader(shaderPath + "HeightField.comp");
+	ComputeShader heightPyramidShader(shaderPath + "HeightPyramid.comp");
+	ComputeShader honmoonBakeShader(shaderPath + "HonmoonBake.comp");
+	ComputeShader geodesicFieldShader(shaderPath + "GeodesicField.comp");
+	ComputeShader rippleBinShader(shaderPath + "RippleBin.comp");
+	Shader depthDownsampleShader(shaderPath + "Fullscreen.vert", shaderPath + "DepthDownsample.frag");
+	Shader bilateralUpsampleShader(shaderPath + "Fullscreen.vert", shaderPath + "BilateralUpsample.frag");
+	Shader oitResolveShader(shaderPath + "Fullscreen.vert", shaderPath + "OITResolve.frag");
 #pragma endregion
 
 #pragma region Models
@@ -154,19 +410,11 @@ int main() {
 #pragma endregion
 
 #pragma region Honmoon
-	struct HonmoonVertex {
-		glm::vec2 texCoords;
-	};
-
-	std::vector<HonmoonVertex> Honmoon_vertices;
-	std::vector<GLuint> indices;
-	int width = SCR_WIDTH;
-	int height = SCR_HEIGHT;
-
 	int gridSizeX = 100;
 	int gridSizeZ = 100;
 	float spacing = 1.0f;
 
+	// The covered area is fixed by the initial grid, resolutions below only change how finely it is sampled
 	glm::vec3 HonmoonScale = glm::vec3(0.5f);
 	glm::vec3 HonmoonSize = glm::vec3(gridSizeX, 0.0f, gridSizeZ) * spacing * HonmoonScale;
 	glm::vec3 HonmoonPosition = glm::vec3(-HonmoonSize / 2.0f);
@@ -174,102 +422,61 @@ int main() {
 
 	glm::vec2 Honmoon_GlobalOrigin = glm::vec2(HonmoonCenter.x, HonmoonCenter.z);
 
-	for (int z = 0; z <= gridSizeZ; z++) {
-		for (int x = 0; x <= gridSizeX; x++) {
-			glm::vec2 texCoord = glm::vec2(x, z) / glm::vec2(gridSizeX, gridSizeZ);
-			Honmoon_vertices.push_back({ texCoord });
-		}
-	}
-
-	int meshWidth = gridSizeX + 1;
-	int meshHeight = gridSizeZ + 1;
-
-	for (int z = 0; z < gridSizeZ - 1; z++) {  // skip last row
-		for (int x = 0; x < gridSizeX - 1; x++) {  // skip last column
-			int i0 = z * meshWidth + x;
-			int i1 = i0 + 1;
-			int i2 = i0 + meshWidth;
-			int i3 = i2 + 1;
-
-			// two triangles per quad
-			indices.push_back(i0);
-			indices.push_back(i2);
-			indices.push_back(i1);
-
-			indices.push_back(i1);
-			indices.push_back(i2);
-			indices.push_back(i3);
-		}
-	}
-
-
-	GLuint Honmoon_VAO, Honmoon_VBO, Honmoon_EBO;
-	glGenVertexArrays(1, &Honmoon_VAO);
-	glGenBuffers(1, &Honmoon_VBO);
-	glGenBuffers(1, &Honmoon_EBO);
-
-	glBindVertexArray(Honmoon_VAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, Honmoon_VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(HonmoonVertex) * Honmoon_vertices.size(), Honmoon_vertices.data(), GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Honmoon_EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)* indices.size(), indices.data(), GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0); // Position
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HonmoonVertex), (void*)0);
-
-	glBindVertexArray(0);
+	int heightMapResolution = gridSizeX;
+	int gridResolution = gridSizeX;
+
+	HonmoonGrid honmoonGrid(gridResolution, gridResolution, honmoonBakeShader);
+
+	// Adaptive alternative to the uniform grid, gridResolution is then its finest level
+	int patchSize = 16;
+	float lodDistance = 10.0f;
+	HonmoonQuadtree honmoonQuadtree(patchSize);
+
+	// Extra barriers, rescattered only when their layout changes so the render thread uploads them once
+	int barrierCount = 0;
+	float barrierSize = 4.0f;
+	int barrierGridResolution = 32;
+	std::shared_ptr<const BarrierList> barriers;
+	glm::vec3 barrierArea = glm::vec3(0.0f);
+	int scatteredCount = -1;
+	float scatteredSize = 0.0f;
+	HonmoonBarriers honmoonBarriers(barrierGridResolution);
+
+	// Random impacts over the area, ripplesPerSecond of them plus any burst
+	RippleEvents rippleEvents(rippleBinShader);
+	float ripplesPerSecond = 20.0f;
+	float rippleSpeed = 4.0f;
+	float rippleWavelength = 0.5f;
+	float rippleLifetime = 3.0f;
+	float rippleAmplitude = 0.15f;
+	float rippleBacklog = 0.0f;
+	std::mt19937 rippleRandom(1234);
+	std::vector<RippleEvent> ripples;
 
 	float hoverHeight = 0.0f;
 	float thickness = 1.0f;
 	float ringspacing = 1.0f;
 
-	float progress = 0.0f;
+	float progress = 1.0f;
+
+	// Stretches the covered area around its center, the clipmap keeps detail near the camera
+	float areaScale = 1.0f;
+	float clipmapTexelSize = 0.05f;
+	int clipmapTileBudget = 32;
 
 	honmoonShader.use();
-	honmoonShader.setInt("terrrainHeight", 0);
+	honmoonShader.setInt("heightField", 0);
+	honmoonShader.setInt("heightClipmap", 1);
+	honmoonShader.setInt("geodesicField", 2);
+	honmoonBakedShader.use();
+	honmoonBakedShader.setInt("geodesicField", 2);
 #pragma endregion
 
 #pragma region Height map
-	unsigned int depthMapFBO;
-	glGenFramebuffers(1, &depthMapFBO);
-
-	// create depth texture
-	unsigned int depthMap;
-	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(
-		GL_TEXTURE_2D,
-		0,
-		GL_DEPTH_COMPONENT,
-		gridSizeX, gridSizeZ,
-		0,
-		GL_DEPTH_COMPONENT,
-		GL_FLOAT,
-		NULL
-	);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-	float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-	// attach to framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-
-	// no color buffer
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "Framebuffer not complete!" << std::endl;
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	HeightMap heightMap(heightMapResolution, heightMapResolution);
+	HeightField heightField(heightMapResolution, heightMapResolution, heightFieldShader, heightPyramidShader);
+	HeightClipmap heightClipmap(currentPath + "\\cache\\heightclipmap");
+	GeodesicField geodesicField(heightMapResolution, heightMapResolution, geodesicFieldShader);
 #pragma endregion
 
 #pragma region Quad
@@ -288,7 +495,7 @@ int main() {
 	glGenVertexArrays(1, &quadVAO);
 	glGenBuffers(1, &quadVBO);
 
-	glBindVertexArray(quadVAO);
+	GLState::BindVertexArray(quadVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
 
@@ -298,121 +505,699 @@ int main() {
 	glEnableVertexAttribArray(1); // TexCoords
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
 #pragma endregion
 
-#pragma region Time Variables
-	float myTime = 0.0f;
-	float lastTime = 0.0f;
-	float dt = 0.0f;
+#pragma region Low Resolution Honmoon
+	// Draws the Honmoon at half or quarter resolution, into targets from the render graph
+	LowResPass lowResPass(depthDownsampleShader, bilateralUpsampleShader, quadVAO);
+	// Accumulation and revealage at the same resolution, for overlapping layers in any order
+	WeightedOIT weightedOIT(oitResolveShader, quadVAO);
 #pragma endregion
 
-#pragma region Main Loop
-	while (!glfwWindowShouldClose(window)) {
-#pragma region Time
-		myTime = static_cast<float>(glfwGetTime());
-		dt = myTime - lastTime;
-		lastTime = myTime;
+#pragma region Deferred Shading
+	// Lights the scene's G-buffer in one fullscreen pass into whichever target the terrain goes to
+	GBuffer gBuffer(deferredLightingShader, quadVAO);
 #pragma endregion
 
-#pragma region Update
-
-#pragma region Inputs
-		glfwPollEvents();
+#pragma region Point Lights
+	// Lanterns over the Honmoon area, rescattered only when their layout changes
+	LightClusters lightClusters;
+	int lanternCount = 256;
+	float lanternRadius = 3.0f;
+	float lanternHeight = 1.0f;
+	float lanternIntensity = 4.0f;
+	std::shared_ptr<const PointLightList> lanterns;
+	glm::vec4 scatteredLanterns = glm::vec4(-1.0f);
+	glm::vec3 lanternArea = glm::vec3(0.0f);
+#pragma endregion
 
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+#pragma region Render Thread
+	FrameQueue frameQueue;
+
+	// The render thread owns the context from here on
+	glfwMakeContextCurrent(nullptr);
+
+	std::thread renderThread([&]() {
+		glfwMakeContextCurrent(window);
+		glfwSwapInterval(1);
+
+#pragma region Command Buffers
+		WorkerPool recordWorkers;
+		std::vector<CommandBuffer> commandBuffers(recordWorkers.size());
+
+		UniformCache heightUniforms;
+		UniformCache basicUniforms;
+		UniformCache gBufferUniforms;
+		ResolveSceneUniforms(models, heightShader, heightUniforms, true);
+		ResolveSceneUniforms(models, basicShader, basicUniforms);
+		ResolveSceneUniforms(models, gBufferShader, gBufferUniforms);
+
+		UniformCache prepassUniforms;
+		ResolveSceneUniforms(models, depthPrepassShader, prepassUniforms, true);
+
+		// Bind counts of the replayed scene passes
+		ReplayState replayState;
+
+		auto drawScene = [&](const FramePacket& frame, const DrawList& drawList, Shader& shader, const UniformCache& uniforms, bool depthOnly) {
+			if (frame.settings.useCommandBuffers) {
+				RecordScene(models, drawList, shader, uniforms, recordWorkers, commandBuffers, depthOnly);
+				ReplayScene(commandBuffers, replayState);
+			}
+			else {
+				DrawScene(models, drawList, shader, depthOnly);
+			}
+		};
+
+		// Positions only, colors masked. The shading pass after it tests GL_EQUAL without writing depth,
+		// so the expensive fragment shader runs once per pixel whatever the draw order.
+		auto drawDepthPrepass = [&](const FramePacket& frame, const DrawList& drawList) {
+			depthPrepassShader.use();
+			depthPrepassShader.setMat4("view", frame.camera.viewMatrix);
+			depthPrepassShader.setMat4("projection", frame.camera.projectionMatrix);
+
+			GLState::ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			drawScene(frame, drawList, depthPrepassShader, prepassUniforms, true);
+			GLState::ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+			GLState::DepthFunc(GL_EQUAL);
+			GLState::DepthMask(GL_FALSE);
+		};
 #pragma endregion
 
-#pragma region Camera
-		camera.update(window, dt);
+		// Passes of each frame and the pooled targets behind them
+		RenderGraph renderGraph;
+
+		// Scene draws sorted by state, then depth
+		RenderQueue renderQueue;
+		DrawList queuedDrawList;
+		const MaterialTable materials = AssignMaterials(models);
+
+		RenderStats stats;
+		stats.recordThreads = recordWorkers.size();
+		stats.pipelineStatistics = GpuQuery::PipelineStatisticsSupported();
+
+		// Scene cost without and with the depth pre-pass, so the two can be compared
+		GpuQuery sceneTimers[2] = { GpuQuery(GL_TIME_ELAPSED), GpuQuery(GL_TIME_ELAPSED) };
+		GpuQuery shadingFragments[2] = { GpuQuery(GL_FRAGMENT_SHADER_INVOCATIONS), GpuQuery(GL_FRAGMENT_SHADER_INVOCATIONS) };
+
+		// GPU time of the whole Honmoon pass, kept per resolution so they can be compared
+		GpuQuery honmoonTimer(GL_TIME_ELAPSED);
+		int honmoonTimerResolution = 0;
+
+		CpuHeightMap cpuHeightMap(heightMap.getWidth(), heightMap.getHeight());
+		std::vector<float> gpuDepth;
+
+		// Height map copies on their way to the main thread, with the placement each was drawn for
+		AsyncReadback heightReadback(3);
+		std::unordered_map<unsigned long long, HonmoonParams> readbackRequests;
+		bool readbackStale = true;
+
+		while (const FramePacket* packet = frameQueue.beginRead()) {
+			const FramePacket& frame = *packet;
+			auto renderStart = std::chrono::high_resolution_clock::now();
+
+			GLState::SetFiltering(frame.settings.filterGLState);
+			GLState::ResetCounters();
+
+			// Targets are sized from the frame, a window resize reallocates them here and nowhere else
+			renderGraph.reset(frame.width, frame.height);
+			RenderGraph::Resource backbuffer = renderGraph.getBackbuffer();
+
+#pragma region Height map
+			heightReadback.poll(frame.frameIndex, [&](const AsyncReadback::Result& result) {
+				auto request = readbackRequests.find(result.tag);
+				if (request == readbackRequests.end()) return;
+
+				auto snapshot = std::make_shared<HeightMapSnapshot>();
+				snapshot->frameIndex = result.frame;
+				snapshot->width = result.width;
+				snapshot->height = result.height;
+				snapshot->honmoon = request->second;
+
+				const float* depth = static_cast<const float*>(result.data);
+				snapshot->depth.assign(depth, depth + size_t(result.width) * result.height);
+
+				readbackRequests.erase(request);
+				frameQueue.publishHeightMap(std::move(snapshot));
+			});
+
+			heightMap.resize(frame.honmoon.heightMapResolution, frame.honmoon.heightMapResolution);
+			heightField.resize(frame.honmoon.heightMapResolution, frame.honmoon.heightMapResolution);
+			geodesicField.resize(frame.honmoon.heightMapResolution, frame.honmoon.heightMapResolution);
+
+			// Kept across frames, so to the graph it is an import the Honmoon reads
+			RenderGraph::Resource heightFieldTexture = renderGraph.importTexture("Height field", heightField.getTexture(), heightField.getWidth(), heightField.getHeight());
+
+			renderGraph.addPass("Height map", [&](const RenderGraph&) {
+				if (!frame.settings.cacheHeightMap) heightMap.invalidate();
+				heightField.pollRanges();
+
+				stats.heightMapRegenerated = heightMap.update(frame.honmoon, frame.drawList, frame.dirtyBounds, [&](const glm::mat4& view, const glm::mat4& projection, const DrawList& drawList) {
+					heightShader.use();
+
+					heightShader.setMat4("view", view);
+					heightShader.setMat4("projection", projection);
+
+					drawScene(frame, drawList, heightShader, heightUniforms, true);
+				});
+
+				if (stats.heightMapRegenerated) {
+					heightField.refresh(heightMap, frame.honmoon);
+					stats.heightMapRegenerations++;
+				}
+				stats.heightMapCpuMs = heightMap.getCpuMs();
+				stats.heightMapGpuMs = heightMap.getGpuMs();
+				stats.heightMapTiles = heightMap.getTileCount();
+				stats.heightMapTilesUpdated = heightMap.getTilesUpdated();
+
+				stats.geodesicBuilt = false;
+				if (frame.settings.useGeodesic) stats.geodesicBuilt = geodesicField.update(heightField, frame.honmoon, stats.heightMapRegenerated);
+				else geodesicField.invalidate();
+				stats.geodesicBuilds = geodesicField.getBuildCount();
+				stats.geodesicPasses = geodesicField.getPasses();
+				stats.geodesicGpuMs = geodesicField.getGpuMs();
+
+				// Retried next frame if the ring was full
+				readbackStale = readbackStale || stats.heightMapRegenerated;
+				if (frame.settings.readbackHeightMap && readbackStale) {
+					if (heightReadback.readTexture(heightMap.getTexture(), 0, heightMap.getWidth(), heightMap.getHeight(), GL_DEPTH_COMPONENT, GL_FLOAT, frame.frameIndex)) {
+						readbackRequests[frame.frameIndex] = frame.honmoon;
+						readbackStale = false;
+					}
+				}
+
+				// Whether it is on or not, so turning it back on never shows tiles from before a move
+				heightClipmap.invalidate(frame.dirtyBounds);
+				if (frame.settings.useClipmap) {
+					heightClipmap.update(frame.camera.Position, frame.honmoon, frame.honmoon.clipmapTexelSize, frame.honmoon.clipmapTileBudget, frame.drawList, [&](const glm::mat4& view, const glm::mat4& projection, const DrawList& drawList) {
+						heightShader.use();
+
+						heightShader.setMat4("view", view);
+						heightShader.setMat4("projection", projection);
+
+						drawScene(frame, drawList, heightShader, heightUniforms, true);
+					});
+				}
+				stats.clipmapTilesRendered = frame.settings.useClipmap ? heightClipmap.getTilesRendered() : 0;
+				stats.clipmapTilesLoaded = frame.settings.useClipmap ? heightClipmap.getTilesLoaded() : 0;
+				stats.clipmapTilesPending = heightClipmap.getTilesPending();
+				stats.clipmapCachedTiles = heightClipmap.getCachedTiles();
+				stats.clipmapCacheBytes = heightClipmap.getCacheBytes();
+
+				stats.readbackRequested = heightReadback.getRequested();
+				stats.readbackCompleted = heightReadback.getCompleted();
+				stats.readbackDropped = heightReadback.getDropped();
+				stats.readbackInFlight = heightReadback.getInFlight();
+				stats.readbackLatencyFrames = heightReadback.getLastLatencyFrames();
+				stats.readbackLatencyMs = heightReadback.getAverageLatencyMs();
+				stats.readbackThroughputMBs = heightReadback.getThroughputMBs() + heightClipmap.getReadback().getThroughputMBs();
+				stats.clipmapTilesUncached = heightClipmap.getReadback().getDropped();
+			}).writeStorage(heightFieldTexture);
 #pragma endregion
 
-		processInput(window);
+#pragma region Point Lights
+			// Kept across frames like the height field, the scene shading binds them
+			RenderGraph::Resource lightBuffers = renderGraph.importBuffer("Light clusters");
+
+			renderGraph.addPass("Light assignment", [&](const RenderGraph&) {
+				if (frame.settings.clusteredLights)
+					lightClusters.update(frame.pointLights, frame.camera, frame.width, frame.height, recordWorkers);
+
+				stats.pointLights = lightClusters.getLightCount();
+				stats.lightIndices = lightClusters.getIndexCount();
+				stats.lightClustersOccupied = lightClusters.getOccupiedClusters();
+				stats.maxLightsPerCluster = lightClusters.getMaxLightsPerCluster();
+				stats.lightUploads = lightClusters.getUploadCount();
+				stats.lightAssignMs = lightClusters.getAssignMs();
+			}).writeStorage(lightBuffers);
 #pragma endregion
 
-#pragma region Render
+#pragma region Render Queue
+			// Draw list order unless the queue reorders it
+			const DrawList* sceneDrawList = &frame.drawList;
 
-#pragma region Height map
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-		glViewport(0, 0, gridSizeX, gridSizeZ);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		
-		float near_plane = 0.1f, far_plane = 100.0f;
-		float yCamOffset = 50.0;
+			if (frame.settings.useRenderQueue) {
+				auto queueStart = std::chrono::high_resolution_clock::now();
+
+				const CameraData& camera = frame.camera;
+				float farPlane = camera.projectionMatrix[3][2] / (camera.projectionMatrix[2][2] + 1.0f);
+				unsigned int sceneProgram = frame.settings.deferredShading ? gBufferShader.ID : basicShader.ID;
 
-		// Top-down view: camera above the scene, looking down the -Y axis
-		glm::vec3 camPos = HonmoonCenter + glm::vec3(0.0f, yCamOffset, 0.0f);  // move this up if scene is taller
-		glm::vec3 target = HonmoonCenter;
-		glm::vec3 upVector = glm::vec3(0.0f, 0.0f, -1.0f); // "up" is -Z when looking down Y
+				renderQueue.clear();
+				for (size_t i = 0; i < frame.drawList.size(); i++) {
+					const DrawItem& item = frame.drawList[i];
+					glm::vec3 offset = camera.Position - glm::clamp(camera.Position, item.worldBounds.min, item.worldBounds.max);
 
-		float orthoSizeX = HonmoonSize.x / 2.0f;
-		float orthoSizeZ = HonmoonSize.z / 2.0f;
+					uint64_t key = RenderQueue::MakeKey(0, false, sceneProgram, materials[item.modelIndex][item.meshIndex], glm::length(offset), farPlane);
+					renderQueue.push(key, uint32_t(i));
+				}
+				renderQueue.sort();
 
-		glm::mat4 view = glm::lookAt(camPos, target, upVector);
-		glm::mat4 ortho = glm::ortho(
-			-orthoSizeX, orthoSizeX,   // left, right
-			-orthoSizeZ, orthoSizeZ,   // bottom, top
-			near_plane, far_plane
-		);
+				queuedDrawList.clear();
+				for (const RenderQueue::Item& item : renderQueue.getItems())
+					queuedDrawList.push_back(frame.drawList[item.payload]);
+				sceneDrawList = &queuedDrawList;
 
-		heightShader.use();
+				stats.renderQueueMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - queueStart).count();
+				stats.renderQueueSortPasses = renderQueue.getLastSortPasses();
+			}
+			stats.renderQueueItems = frame.settings.useRenderQueue ? renderQueue.size() : 0;
+#pragma endregion
+
+#pragma region Ripples
+			RenderGraph::Resource rippleBuffers = renderGraph.importBuffer("Ripple bins");
 
-		heightShader.setMat4("view", view);
-		heightShader.setMat4("projection", ortho);
+			renderGraph.addPass("Ripple binning", [&](const RenderGraph&) {
+				rippleEvents.push(frame.ripples);
+				if (frame.settings.useRipples) rippleEvents.bin(frame.honmoon, frame.time);
 
-		DrawScene(models, indexes, modelProperties, heightShader);
+				stats.rippleLive = rippleEvents.getLiveCount(frame.time, frame.honmoon.rippleLifetime);
+				stats.ripplesPushed = rippleEvents.getPushedCount();
+				stats.rippleBinGpuMs = rippleEvents.getGpuMs();
+			}).writeStorage(rippleBuffers);
 #pragma endregion
 
 #pragma region Terrain
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			// The low resolution Honmoon needs the scene depth, so the scene goes offscreen first.
+			// Weighted blending needs it too, at full resolution it goes through the same pass with a divisor of 1.
+			bool weightedBlended = frame.settings.weightedBlendedOIT;
+			bool lowResHonmoon = frame.settings.honmoonResolution > 0 || weightedBlended;
+			lowResPass.setDivisor(1 << frame.settings.honmoonResolution);
+
+			RenderGraph::Resource sceneColor = backbuffer;
+			RenderGraph::Resource sceneDepth = backbuffer;
+			if (lowResHonmoon) {
+				sceneColor = renderGraph.createTexture("Scene color", { LowResPass::SceneColorFormat });
+				sceneDepth = renderGraph.createTexture("Scene depth", { LowResPass::DepthFormat });
+			}
+
+			int prepass = frame.settings.depthPrepass ? 1 : 0;
+			for (int mode = 0; mode < 2; mode++) {
+				if (sceneTimers[mode].poll()) stats.sceneGpuMs[mode] = sceneTimers[mode].getResult() / 1000000.0f;
+				if (shadingFragments[mode].poll()) stats.sceneFragments[mode] = shadingFragments[mode].getResult();
+			}
+
+			if (frame.settings.deferredShading) {
+				RenderGraph::Resource gAlbedo = renderGraph.createTexture("G-buffer albedo", { GBuffer::AlbedoFormat });
+				RenderGraph::Resource gNormal = renderGraph.createTexture("G-buffer normal", { GBuffer::NormalFormat });
+				RenderGraph::Resource gDepth = renderGraph.createTexture("G-buffer depth", { GBuffer::DepthFormat });
+
+				renderGraph.addPass("G-buffer", [&](const RenderGraph&) {
+					// Scene binds only, not the height map's
+					replayState = ReplayState();
+					sceneTimers[prepass].begin();
+
+					glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+					gBuffer.beginGeometry();
+					if (prepass) drawDepthPrepass(frame, *sceneDrawList);
+
+					gBufferShader.use();
+
+					gBufferShader.setMat4("view", frame.camera.viewMatrix);
+					gBufferShader.setMat4("projection", frame.camera.projectionMatrix);
+					gBufferShader.setFloat("roughness", GBuffer::DefaultRoughness);
+
+					shadingFragments[prepass].begin();
+					drawScene(frame, *sceneDrawList, gBufferShader, gBufferUniforms, false);
+					shadingFragments[prepass].end();
+
+					GLState::DepthFunc(GL_LESS);
+					GLState::DepthMask(GL_TRUE);
+				}).write(gAlbedo).write(gNormal).writeDepth(gDepth);
+
+				// Declared in this block, so captured by value
+				renderGraph.addPass("Deferred lighting", [&, gAlbedo, gNormal, gDepth](const RenderGraph& graph) {
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+					deferredLightingShader.use();
+					if (frame.settings.clusteredLights) lightClusters.bind(deferredLightingShader);
+					else deferredLightingShader.setBool("useClusteredLights", false);
+					deferredLightingShader.setBool("showLightDensity", frame.settings.showLightDensity);
+
+					gBuffer.light({ graph.getTexture(gAlbedo), graph.getTexture(gNormal), graph.getTexture(gDepth) }, frame.camera, frame.light);
+					sceneTimers[prepass].end();
+				}).read(gAlbedo).read(gNormal).read(gDepth).read(lightBuffers).write(sceneColor).writeDepth(sceneDepth);
+			}
+			else {
+				renderGraph.addPass("Forward", [&](const RenderGraph&) {
+					// Scene binds only, not the height map's
+					replayState = ReplayState();
+					sceneTimers[prepass].begin();
+
+					glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					if (prepass) drawDepthPrepass(frame, *sceneDrawList);
+
+					basicShader.use();
+
+					basicShader.setMat4("view", frame.camera.viewMatrix);
+					basicShader.setMat4("projection", frame.camera.projectionMatrix);
+
+					basicShader.setVec3("viewPos", frame.camera.Position);
+
+					basicShader.setVec3("dirLight.direction", frame.light.direction);
+					basicShader.setVec3("dirLight.ambient", glm::vec3(frame.light.ambient));
+					basicShader.setVec3("dirLight.diffuse", glm::vec3(frame.light.diffuse));
+					basicShader.setVec3("dirLight.specular", glm::vec3(frame.light.specular));
+					basicShader.setVec3("dirLight.color", glm::vec3(1.0f));
+
+					if (frame.settings.clusteredLights) lightClusters.bind(basicShader);
+					else basicShader.setBool("useClusteredLights", false);
+					basicShader.setBool("showLightDensity", frame.settings.showLightDensity);
+
+					shadingFragments[prepass].begin();
+					drawScene(frame, *sceneDrawList, basicShader, basicUniforms, false);
+					shadingFragments[prepass].end();
+
+					GLState::DepthFunc(GL_LESS);
+					GLState::DepthMask(GL_TRUE);
+					sceneTimers[prepass].end();
+				}).read(lightBuffers).write(sceneColor).writeDepth(sceneDepth);
+			}
+
+			stats.depthPrepass = prepass;
+			stats.gBufferBytes = frame.settings.deferredShading ? size_t(frame.width) * frame.height * GBuffer::BytesPerPixel : 0;
+#pragma endregion
+
+#pragma region Honmoon
+			if (honmoonTimer.poll()) stats.honmoonGpuMs[honmoonTimerResolution] = honmoonTimer.getResult() / 1000000.0f;
+
+			// Measured from the first Honmoon pass to the last, whichever they are this frame
+			auto beginHonmoonTimer = [&]() {
+				if (honmoonTimer.begin()) honmoonTimerResolution = frame.settings.honmoonResolution;
+			};
+
+			// Where the Honmoon blends: the window over the scene, or the low resolution target
+			RenderGraph::Resource lowColor = backbuffer;
+			RenderGraph::Resource lowDepth = backbuffer;
+			if (lowResHonmoon) {
+				lowColor = renderGraph.createTexture("Low resolution color", { LowResPass::LowColorFormat, lowResPass.getDivisor() });
+				lowDepth = renderGraph.createTexture("Low resolution depth", { LowResPass::DepthFormat, lowResPass.getDivisor() });
+
+				renderGraph.addPass("Depth downsample", [&](const RenderGraph& graph) {
+					beginHonmoonTimer();
+					lowResPass.downsampleDepth(graph.getTexture(sceneDepth));
+				}).read(sceneDepth).write(lowColor).writeDepth(lowDepth);
+			}
+
+			RenderGraph::PassBuilder honmoonPass = renderGraph.addPass("Honmoon", [&](const RenderGraph&) {
+				if (!lowResHonmoon) beginHonmoonTimer();
+				if (weightedBlended) weightedOIT.begin();
+
+				bool bakedGrid = !frame.settings.adaptiveGrid && frame.settings.gridMode == (int)HonmoonGrid::Mode::BAKED;
+
+				stats.gridBaked = false;
+				if (!frame.settings.adaptiveGrid) {
+					honmoonGrid.setMode((HonmoonGrid::Mode)frame.settings.gridMode);
+					honmoonGrid.resize(frame.honmoon.gridResolution, frame.honmoon.gridResolution);
+					stats.gridBaked = honmoonGrid.bake(frame.honmoon, heightField);
+				}
+
+				// Baked vertices are already displaced, so the surface shader is just a projection
+				Shader& surfaceShader = bakedGrid ? honmoonBakedShader : honmoonShader;
+				surfaceShader.use();
+
+				surfaceShader.setMat4("view", frame.camera.viewMatrix);
+				surfaceShader.setMat4("projection", frame.camera.projectionMatrix);
+
+				surfaceShader.setVec2("patternOrigin", frame.honmoon.patternOrigin);
+				surfaceShader.setFloat("spacing", frame.honmoon.spacing);
+				surfaceShader.setFloat("thickness", frame.honmoon.thickness);
+				surfaceShader.setVec4("color1", frame.honmoon.color1);
+				surfaceShader.setVec4("color2", frame.honmoon.color2);
+
+				surfaceShader.setFloat("progress", frame.honmoon.progress);
+				surfaceShader.setVec3("origin", frame.honmoon.position);
+				surfaceShader.setVec3("size", frame.honmoon.size);
+				surfaceShader.setBool("weightedBlended", weightedBlended);
+
+				if (frame.settings.useGeodesic) geodesicField.bind(surfaceShader, 2);
+				else surfaceShader.setBool("useGeodesic", false);
+
+				if (frame.settings.useRipples) rippleEvents.bind(surfaceShader, frame.honmoon, frame.time);
+				else surfaceShader.setBool("useRipples", false);
+
+				if (bakedGrid) {
+					honmoonGrid.Draw(surfaceShader);
+				}
+				else {
+					honmoonShader.setFloat("hoverHeight", frame.honmoon.hoverHeight);
+					honmoonShader.setVec3("cameraPosition", frame.camera.Position);
+
+					honmoonShader.setBool("useClipmap", frame.settings.useClipmap);
+					if (frame.settings.useClipmap) heightClipmap.bind(honmoonShader, 1);
+
+					GLState::ActiveTexture(GL_TEXTURE0);
+					GLState::BindTexture(GL_TEXTURE_2D, heightField.getTexture());
+
+					if (frame.settings.adaptiveGrid) {
+						honmoonQuadtree.setPatchSize(frame.honmoon.patchSize);
+						honmoonQuadtree.select(frame.honmoon, frame.camera, heightField, frame.honmoon.gridResolution, frame.honmoon.lodDistance);
+						honmoonQuadtree.Draw(honmoonShader);
+					}
+					else {
+						float texelsPerCell = heightField.getWidth() / (float)honmoonGrid.getSizeX();
+						honmoonShader.setVec2("gridSize", glm::vec2(honmoonGrid.getSizeX(), honmoonGrid.getSizeZ()));
+						honmoonShader.setFloat("heightLod", std::max(std::log2(texelsPerCell), 0.0f));
+
+						honmoonGrid.Draw(honmoonShader);
+					}
+				}
+
+				// Whatever the count, one upload when the list changes and one draw call
+				stats.barriersUploaded = honmoonBarriers.update(frame.barriers, frame.honmoon);
+				auto barrierStart = std::chrono::high_resolution_clock::now();
+
+				if (honmoonBarriers.getCount() > 0) {
+					honmoonBarriers.setGridSize(frame.honmoon.barrierGridResolution);
+
+					honmoonShader.use();
+					honmoonShader.setMat4("view", frame.camera.viewMatrix);
+					honmoonShader.setMat4("projection", frame.camera.projectionMatrix);
+					honmoonShader.setBool("weightedBlended", weightedBlended);
+
+					honmoonShader.setBool("useClipmap", frame.settings.useClipmap);
+					if (frame.settings.useClipmap) heightClipmap.bind(honmoonShader, 1);
+
+					if (frame.settings.useRipples) rippleEvents.bind(honmoonShader, frame.honmoon, frame.time);
+					else honmoonShader.setBool("useRipples", false);
+
+					GLState::ActiveTexture(GL_TEXTURE0);
+					GLState::BindTexture(GL_TEXTURE_2D, heightField.getTexture());
+
+					honmoonBarriers.Draw(honmoonShader);
+				}
+
+				stats.barrierSubmitMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - barrierStart).count();
+				stats.barrierCount = honmoonBarriers.getCount();
+				stats.barrierUploads = honmoonBarriers.getUploadCount();
+				stats.barrierUploadMs = honmoonBarriers.getUploadMs();
+
+				if (!lowResHonmoon) honmoonTimer.end();
+			});
+			honmoonPass.read(heightFieldTexture).read(rippleBuffers);
+
+			if (weightedBlended) {
+				RenderGraph::Resource accumulation = renderGraph.createTexture("Accumulation", { WeightedOIT::AccumulationFormat, lowResPass.getDivisor() });
+				RenderGraph::Resource revealage = renderGraph.createTexture("Revealage", { WeightedOIT::RevealageFormat, lowResPass.getDivisor() });
+				honmoonPass.write(accumulation).write(revealage).readDepth(lowDepth);
+
+				renderGraph.addPass("Weighted blending resolve", [&, accumulation, revealage](const RenderGraph& graph) {
+					weightedOIT.resolve(graph.getTexture(accumulation), graph.getTexture(revealage));
+				}).read(accumulation).read(revealage).write(lowColor);
+			}
+			else {
+				honmoonPass.write(lowColor).readDepth(lowDepth);
+			}
+
+			if (lowResHonmoon) {
+				renderGraph.addPass("Composite", [&](const RenderGraph& graph) {
+					LowResPass::Targets targets = { graph.getTexture(sceneDepth), graph.getTexture(lowColor), graph.getTexture(lowDepth) };
+					lowResPass.composite(graph.getFramebuffer(sceneColor), targets, graph.getWidth(sceneColor), graph.getHeight(sceneColor), frame.camera.projectionMatrix);
+
+					honmoonTimer.end();
+				}).read(sceneColor).read(sceneDepth).read(lowColor).read(lowDepth).write(backbuffer);
+			}
+#pragma endregion
+
+#pragma region Render Graph
+			renderGraph.compile();
+			renderGraph.execute();
+
+			const RenderGraph::Stats& graphStats = renderGraph.getStats();
+			stats.renderGraphPasses = graphStats.passes;
+			stats.renderGraphCulled = graphStats.culled;
+			stats.renderGraphOrder = graphStats.order;
+			stats.renderGraphTargets = graphStats.targets;
+			stats.renderGraphTextures = graphStats.textures;
+			stats.renderGraphBytes = graphStats.bytes;
+			stats.renderGraphUnaliasedBytes = graphStats.unaliasedBytes;
+			stats.renderGraphAllocations = graphStats.allocations;
+			stats.renderGraphCompileMs = graphStats.compileMs;
+#pragma endregion
 
-		basicShader.use();
+			stats.honmoonResolution = frame.settings.honmoonResolution;
 
-		basicShader.setMat4("view", camera.viewMatrix);
-		basicShader.setMat4("projection", camera.projectionMatrix);
+			stats.quadtreeLevels = honmoonQuadtree.getLevelCount();
+			stats.quadtreePatches = honmoonQuadtree.getPatchCount();
+			stats.quadtreeTriangles = honmoonQuadtree.getTriangleCount();
+			stats.quadtreeSelectMs = honmoonQuadtree.getSelectMs();
 
-		basicShader.setVec3("viewPos", camera.Position);
+			stats.gridBufferBytes = honmoonGrid.getBufferBytes();
+			stats.gridBakes = honmoonGrid.getBakeCount();
+			stats.gridBuildMs = honmoonGrid.getBuildMs();
+#pragma endregion
 
-		basicShader.setVec3("dirLight.direction", lightDir);
-		basicShader.setVec3("dirLight.ambient", glm::vec3(ambient));
-		basicShader.setVec3("dirLight.diffuse", glm::vec3(diffuse));
-		basicShader.setVec3("dirLight.specular", glm::vec3(specular));
-		basicShader.setVec3("dirLight.color", glm::vec3(1.0f));
+			// Everything up to the GUI, its backend binds and restores state behind the cache's back
+			stats.glCallsIssued = GLState::GetCounters().issued;
+			stats.glCallsFiltered = GLState::GetCounters().filtered;
 
-		DrawScene(models, indexes, modelProperties, basicShader);
+#pragma region GUI
+			ImGui_ImplOpenGL3_RenderDrawData(frame.gui.drawData());
+			GLState::Invalidate();
 #pragma endregion
 
-#pragma region Honmoon
-		honmoonShader.use();
+			glfwSwapBuffers(window);
+
+#pragma region Submission Benchmark
+			if (frame.settings.runSubmissionBenchmark) {
+				const unsigned int meshCounts[] = { 1000, 10000, 100000 };
 
-		honmoonShader.setMat4("view", camera.viewMatrix);
-		honmoonShader.setMat4("projection", camera.projectionMatrix);
+				for (size_t i = 0; i < stats.submissionBenchmark.size(); i++)
+					stats.submissionBenchmark[i] = BenchmarkSubmission(models, basicShader, basicUniforms, recordWorkers, commandBuffers, meshCounts[i]);
 
-		honmoonShader.setFloat("hoverHeight", hoverHeight);
-		honmoonShader.setFloat("yCamOffset", yCamOffset);
-		honmoonShader.setVec3("origin", HonmoonPosition);
-		honmoonShader.setVec3("size", HonmoonSize);
-		honmoonShader.setFloat("far", far_plane);
-		honmoonShader.setFloat("near", near_plane);
+				stats.hasSubmissionBenchmark = true;
+			}
+#pragma endregion
+
+#pragma region CPU Bake Benchmark
+			if (frame.settings.runCpuBakeBenchmark) {
+				cpuHeightMap.resize(heightMap.getWidth(), heightMap.getHeight());
+				cpuHeightMap.bake(models, frame.drawList, frame.honmoon, recordWorkers);
+				stats.cpuBake = cpuHeightMap.getTiming();
+
+				// The cached GPU map is up to date with this frame's draw list
+				heightMap.readDepth(gpuDepth);
+				const std::vector<float>& cpuDepth = cpuHeightMap.getDepth();
+
+				const float tolerance = 0.01f;
+				const float depthRange = HeightMap::farPlane - HeightMap::nearPlane;
+				double errorSum = 0.0;
+				size_t mismatches = 0;
+				stats.cpuBake.maxError = 0.0f;
+
+				for (size_t i = 0; i < cpuDepth.size(); i++) {
+					float error = std::abs(cpuDepth[i] - gpuDepth[i]) * depthRange;
+					stats.cpuBake.maxError = std::max(stats.cpuBake.maxError, error);
+					errorSum += error;
+					if (error > tolerance) mismatches++;
+				}
+
+				stats.cpuBake.meanError = cpuDepth.empty() ? 0.0f : float(errorSum / cpuDepth.size());
+				stats.cpuBake.mismatchPercent = cpuDepth.empty() ? 0.0f : 100.0f * mismatches / cpuDepth.size();
+				stats.hasCpuBake = true;
+			}
+#pragma endregion
+
+#pragma region Grid Benchmark
+			if (frame.settings.runGridBenchmark) {
+				const int gridSizes[] = { 512, 1024, 2048, 4096 };
+
+				for (size_t i = 0; i < stats.gridBenchmark.size(); i++) {
+					// resize() skips a grid already at that size, so release the buffers and size the
+					// procedural grid first, switching back to buffered then always rebuilds
+					honmoonGrid.setMode(HonmoonGrid::Mode::PROCEDURAL);
+					honmoonGrid.resize(gridSizes[i], gridSizes[i]);
+					glFinish();
+
+					auto start = std::chrono::high_resolution_clock::now();
+
+					honmoonGrid.setMode(HonmoonGrid::Mode::BUFFERED);
+					glFinish();
+
+					GridUploadTiming& timing = stats.gridBenchmark[i];
+					timing.gridSize = gridSizes[i];
+					timing.bytes = HonmoonGrid::BufferedBytes(gridSizes[i], gridSizes[i]);
+					timing.buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				}
+
+				// Drop the 4096 buffers before going back to the frame's grid
+				honmoonGrid.setMode((HonmoonGrid::Mode)frame.settings.gridMode);
+				honmoonGrid.resize(frame.honmoon.gridResolution, frame.honmoon.gridResolution);
+
+				stats.hasGridBenchmark = true;
+			}
+#pragma endregion
+
+			// Everything replayed this frame, kept per mode so the two can be compared
+			int queued = frame.settings.useRenderQueue ? 1 : 0;
+			stats.useRenderQueue = queued;
+			stats.bindsIssued[queued] = replayState.issued;
+			stats.bindsSkipped[queued] = replayState.skipped;
+
+			stats.frameIndex = frame.frameIndex;
+			stats.renderMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - renderStart).count();
+
+			frameQueue.endRead();
+			frameQueue.publishStats(stats);
+		}
+
+		glfwMakeContextCurrent(nullptr);
+	});
+#pragma endregion
+
+#pragma region Time Variables
+	float myTime = 0.0f;
+	float lastTime = 0.0f;
+	float dt = 0.0f;
+	unsigned int frameIndex = 0;
+
+	RenderSettings renderSettings;
+	std::vector<Bounds> dirtyBounds;
+#pragma endregion
+
+#pragma region Height Query
+	// Main thread copy of the Honmoon surface, baked on the CPU whenever the scene changes
+	WorkerPool queryWorkers(std::max(std::thread::hardware_concurrency() / 2, 1u));
+	CpuHeightMap queryBake(heightMapResolution, heightMapResolution);
+	HeightQuery heightQuery;
+	glm::vec3 queriedSize = glm::vec3(0.0f);
+	unsigned int queriedFrame = 0;      // height map snapshot the query was built from, 0 for the CPU bake
+
+	// While models are dragged the bake runs at most this often, and once more when they settle
+	const float queryRebakeInterval = 0.1f;
+	bool queryDirty = false;
+	float queryBakedTime = 0.0f;
+
+	std::vector<float> queryX, queryZ;
+	std::vector<SurfaceSample> queryResults;
+	float batchScalarMs = 0.0f, batchMs = 0.0f;
+#pragma endregion
+
+#pragma region Main Loop
+	while (!glfwWindowShouldClose(window)) {
+#pragma region Time
+		myTime = static_cast<float>(glfwGetTime());
+		dt = myTime - lastTime;
+		lastTime = myTime;
+#pragma endregion
 
-		honmoonShader.setVec2("patternOrigin", Honmoon_GlobalOrigin);
-		honmoonShader.setFloat("spacing", spacing);
-		honmoonShader.setFloat("thickness", thickness);
-		honmoonShader.setVec4("color1", glm::vec4(35, 218, 215, 255) / 255.0f); // primary color
-		honmoonShader.setVec4("color2", glm::vec4(4, 90, 107, 10) / 255.0f); // secondary color
+#pragma region Update
+		auto updateStart = std::chrono::high_resolution_clock::now();
 
-		honmoonShader.setFloat("progress", progress);
+#pragma region Inputs
+		glfwPollEvents();
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, depthMap);
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+#pragma endregion
 
-		glBindVertexArray(Honmoon_VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
+#pragma region Camera
+		camera.update(window, dt);
+#pragma endregion
+
+		processInput(window);
 #pragma endregion
 
 #pragma region GUI
@@ -435,6 +1220,39 @@ int main() {
 		ImGui::SliderFloat("hoverHeight", &hoverHeight, 0.0f, 10.0f, "%.2f");
 		ImGui::SliderFloat("thickness", &thickness, 0.0f, 10.0f, "%.2f");
 		ImGui::SliderFloat("spacing", &spacing, 0.0f, 10.0f, "%.2f");
+		ImGui::SliderFloat("Sweep progress", &progress, 0.0f, 1.0f, "%.2f");
+
+		ImGui::Separator();
+
+		ImGui::SliderInt("Height map resolution", &heightMapResolution, 16, 2048);
+		ImGui::SliderInt("Grid resolution", &gridResolution, 4, 4096);
+		ImGui::SliderInt("Patch size", &patchSize, 4, 64);
+		ImGui::SliderFloat("LOD distance", &lodDistance, 1.0f, 100.0f, "%.1f");
+		ImGui::SliderFloat("Area scale", &areaScale, 1.0f, 100.0f, "%.1f");
+		ImGui::SliderFloat("Clipmap texel size", &clipmapTexelSize, 0.01f, 1.0f, "%.3f");
+		ImGui::SliderInt("Clipmap tiles per frame", &clipmapTileBudget, 1, 256);
+
+		ImGui::Separator();
+
+		ImGui::SliderInt("Barriers", &barrierCount, 0, 1024);
+		ImGui::SliderFloat("Barrier size", &barrierSize, 0.5f, 20.0f, "%.1f");
+		ImGui::SliderInt("Barrier grid resolution", &barrierGridResolution, 2, 128);
+
+		ImGui::Separator();
+
+		ImGui::SliderFloat("Ripples per second", &ripplesPerSecond, 0.0f, 2000.0f, "%.0f");
+		ImGui::SliderFloat("Ripple speed", &rippleSpeed, 0.5f, 20.0f, "%.1f");
+		ImGui::SliderFloat("Ripple wavelength", &rippleWavelength, 0.1f, 5.0f, "%.2f");
+		ImGui::SliderFloat("Ripple lifetime", &rippleLifetime, 0.5f, 10.0f, "%.1f");
+		ImGui::SliderFloat("Ripple amplitude", &rippleAmplitude, 0.0f, 2.0f, "%.2f");
+		if (ImGui::Button("Burst of 1000 ripples")) rippleBacklog += 1000.0f;
+
+		ImGui::Separator();
+
+		ImGui::SliderInt("Lanterns", &lanternCount, 0, 4096);
+		ImGui::SliderFloat("Lantern radius", &lanternRadius, 0.5f, 20.0f, "%.1f");
+		ImGui::SliderFloat("Lantern height", &lanternHeight, 0.0f, 10.0f, "%.1f");
+		ImGui::SliderFloat("Lantern intensity", &lanternIntensity, 0.0f, 50.0f, "%.1f");
 
 		ImGui::End();
 
@@ -446,25 +1264,372 @@ int main() {
 			ImGui::BeginChild(index.first.c_str());
 
 			ModelTransforms& transforms = modelProperties[index.second];
+			Bounds oldBounds = TransformBounds(models[index.second].getBounds(), GetModelMatrix(transforms));
+
+			bool changed = false;
+			changed |= ImGui::DragFloat3("Position", &transforms.position.x, 0.01f);
+			changed |= ImGui::DragFloat3("Rotation", &transforms.rotation.x, 0.1f);
+			changed |= ImGui::DragFloat("Scale", &transforms.scale, 0.001f);
 
-			ImGui::DragFloat3("Position", &transforms.position.x, 0.01f);
-			ImGui::DragFloat3("Rotation", &transforms.rotation.x, 0.1f);
-			ImGui::DragFloat("Scale", &transforms.scale, 0.001f);
+			if (changed) {
+				dirtyBounds.push_back(oldBounds);
+				dirtyBounds.push_back(TransformBounds(models[index.second].getBounds(), GetModelMatrix(transforms)));
+			}
 
 			ImGui::EndChild();
 		}
 
 		ImGui::End();
 
+		ImGui::Begin("Renderer");
+
+		RenderStats renderStats = frameQueue.latestStats();
+		float updateMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - updateStart).count();
+
+		ImGui::Text("Main thread:   %.2f ms", updateMs);
+		ImGui::Text("Render thread: %.2f ms (frame %u)", renderStats.renderMs, renderStats.frameIndex);
+		ImGui::Text("Frames in flight: %u", frameIndex - renderStats.frameIndex);
+
+		ImGui::SeparatorText("Height map");
+
+		ImGui::Checkbox("Cache height map", &renderSettings.cacheHeightMap);
+		ImGui::Text("Regenerations: %u", renderStats.heightMapRegenerations);
+		ImGui::Text("Tiles redrawn: %d / %d", renderStats.heightMapTilesUpdated, renderStats.heightMapTiles);
+		ImGui::Text("Pass cost: %.3f ms CPU, %.3f ms GPU", renderStats.heightMapCpuMs, renderStats.heightMapGpuMs);
+		// CPU and GPU run on separate timelines, so the two savings are not added up
+		if (renderStats.heightMapRegenerated) ImGui::Text("Saved this frame: nothing, regenerated");
+		else ImGui::Text("Saved this frame: %.3f ms CPU, %.3f ms GPU", renderStats.heightMapCpuMs, renderStats.heightMapGpuMs);
+
+		bool runCpuBakeBenchmark = ImGui::Button("Benchmark CPU bake");
+
+		if (renderStats.hasCpuBake) {
+			const CpuBakeTiming& bake = renderStats.cpuBake;
+			ImGui::Text("%dx%d, %zu triangles, %d tiles, %u threads", bake.width, bake.height, bake.triangles, bake.tiles, bake.threads);
+			ImGui::Text("Transform %.2f ms, bin %.2f ms, raster %.2f ms", bake.transformMs, bake.binMs, bake.rasterMs);
+			ImGui::Text("%.2f M triangles/s, %.0f tiles/s", bake.trianglesPerSecond / 1e6f, bake.tilesPerSecond);
+			ImGui::Text("vs GPU: max %.4f, mean %.5f, %.2f%% texels off by > 0.01", bake.maxError, bake.meanError, bake.mismatchPercent);
+		}
+
+		ImGui::SeparatorText("Height clipmap");
+
+		ImGui::Checkbox("Use clipmap", &renderSettings.useClipmap);
+		ImGui::Text("Tiles this frame: %d drawn, %d from disk, %d pending", renderStats.clipmapTilesRendered, renderStats.clipmapTilesLoaded, renderStats.clipmapTilesPending);
+		ImGui::Text("Disk cache: %zu tiles, %.2f MB, %llu not cached", renderStats.clipmapCachedTiles, renderStats.clipmapCacheBytes / (1024.0f * 1024.0f), renderStats.clipmapTilesUncached);
+
+		ImGui::SeparatorText("Geodesic rings");
+
+		ImGui::Checkbox("Follow surface", &renderSettings.useGeodesic);
+		ImGui::Text("Builds: %u%s, %d passes, %.3f ms GPU", renderStats.geodesicBuilds, renderStats.geodesicBuilt ? " (this frame)" : "", renderStats.geodesicPasses, renderStats.geodesicGpuMs);
+
+		ImGui::SeparatorText("Readback");
+
+		ImGui::Text("Height maps: %llu requested, %llu delivered, %llu dropped, %d in flight", renderStats.readbackRequested, renderStats.readbackCompleted, renderStats.readbackDropped, renderStats.readbackInFlight);
+		ImGui::Text("Latency: %u frames, %.2f ms", renderStats.readbackLatencyFrames, renderStats.readbackLatencyMs);
+		ImGui::Text("Throughput: %.2f MB/s", renderStats.readbackThroughputMBs);
+
+		ImGui::SeparatorText("Honmoon resolution");
+
+		const char* honmoonResolutions[] = { "Full", "Half", "Quarter" };
+		ImGui::Combo("Honmoon pass", &renderSettings.honmoonResolution, honmoonResolutions, IM_ARRAYSIZE(honmoonResolutions));
+		for (int i = 0; i < 3; i++)
+			ImGui::Text("%-8s %.3f ms GPU%s", honmoonResolutions[i], renderStats.honmoonGpuMs[i], renderStats.honmoonResolution == i ? " (current)" : "");
+		ImGui::Checkbox("Order independent blending", &renderSettings.weightedBlendedOIT);
+
+		ImGui::SeparatorText("Honmoon grid");
+
+		ImGui::Checkbox("Adaptive LOD", &renderSettings.adaptiveGrid);
+		ImGui::Text("Quadtree: %d levels, %zu patches, %zu triangles", renderStats.quadtreeLevels, renderStats.quadtreePatches, renderStats.quadtreeTriangles);
+		ImGui::Text("Selection: %.3f ms", renderStats.quadtreeSelectMs);
+
+		const char* gridModes[] = { "Buffered", "Procedural", "Baked" };
+		ImGui::Combo("Grid mode", &renderSettings.gridMode, gridModes, IM_ARRAYSIZE(gridModes));
+		ImGui::Text("Vertex + index buffers: %.2f MB", renderStats.gridBufferBytes / (1024.0f * 1024.0f));
+		ImGui::Text("Bakes: %u%s", renderStats.gridBakes, renderStats.gridBaked ? " (this frame)" : "");
+		ImGui::Text("Last rebuild: %.3f ms", renderStats.gridBuildMs);
+
+		bool runGridBenchmark = ImGui::Button("Benchmark buffered grid");
+
+		if (renderStats.hasGridBenchmark && ImGui::BeginTable("Grid Benchmark", 3)) {
+			ImGui::TableSetupColumn("Grid");
+			ImGui::TableSetupColumn("Buffers (MB)");
+			ImGui::TableSetupColumn("Upload (ms)");
+			ImGui::TableHeadersRow();
+
+			for (const GridUploadTiming& timing : renderStats.gridBenchmark) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%d^2", timing.gridSize);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", timing.bytes / (1024.0f * 1024.0f));
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", timing.buildMs);
+			}
+
+			ImGui::EndTable();
+		}
+
+		ImGui::SeparatorText("Ripples");
+
+		ImGui::Checkbox("Impact ripples", &renderSettings.useRipples);
+		ImGui::Text("%d live, %llu so far (ring of %d)", renderStats.rippleLive, renderStats.ripplesPushed, RippleEvents::capacity);
+		ImGui::Text("Tile binning: %.3f ms GPU", renderStats.rippleBinGpuMs);
+
+		ImGui::SeparatorText("Barriers");
+
+		ImGui::Text("%zu barriers, %u uploads (last %.3f ms)%s", renderStats.barrierCount, renderStats.barrierUploads, renderStats.barrierUploadMs, renderStats.barriersUploaded ? " (this frame)" : "");
+		ImGui::Text("Draw submission: %.3f ms", renderStats.barrierSubmitMs);
+
+		ImGui::SeparatorText("Shading");
+
+		ImGui::Checkbox("Deferred", &renderSettings.deferredShading);
+		if (renderSettings.deferredShading)
+			ImGui::Text("G-buffer: %d bytes per pixel, %.2f MB", GBuffer::BytesPerPixel, renderStats.gBufferBytes / (1024.0f * 1024.0f));
+
+		ImGui::SeparatorText("Render graph");
+
+		ImGui::Text("%d passes, %d culled, compiled in %.3f ms", renderStats.renderGraphPasses, renderStats.renderGraphCulled, renderStats.renderGraphCompileMs);
+		ImGui::TextWrapped("%s", renderStats.renderGraphOrder.c_str());
+		ImGui::Text("%d targets on %d textures: %.2f MB (%.2f MB unaliased)", renderStats.renderGraphTargets, renderStats.renderGraphTextures, renderStats.renderGraphBytes / (1024.0f * 1024.0f), renderStats.renderGraphUnaliasedBytes / (1024.0f * 1024.0f));
+		ImGui::Text("%u textures allocated so far", renderStats.renderGraphAllocations);
+
+		ImGui::SeparatorText("Render queue");
+
+		ImGui::Checkbox("Sort by state", &renderSettings.useRenderQueue);
+		ImGui::Text("%zu items, %d radix passes, %.3f ms", renderStats.renderQueueItems, renderStats.renderQueueSortPasses, renderStats.renderQueueMs);
+		if (renderSettings.useCommandBuffers) {
+			ImGui::Text("Draw list order: %u binds, %u redundant skipped", renderStats.bindsIssued[0], renderStats.bindsSkipped[0]);
+			ImGui::Text("Render queue:    %u binds, %u redundant skipped", renderStats.bindsIssued[1], renderStats.bindsSkipped[1]);
+		}
+		else {
+			ImGui::TextDisabled("Bind counts need command buffers");
+		}
+
+		ImGui::SeparatorText("GL state cache");
+
+		ImGui::Checkbox("Filter redundant state", &renderSettings.filterGLState);
+		ImGui::Text("%u calls issued, %u filtered", renderStats.glCallsIssued, renderStats.glCallsFiltered);
+
+		ImGui::SeparatorText("Overdraw");
+
+		ImGui::Checkbox("Depth pre-pass", &renderSettings.depthPrepass);
+		ImGui::BeginDisabled(renderSettings.useRenderQueue);
+		ImGui::Checkbox("Front to back", &renderSettings.sortFrontToBack);
+		ImGui::EndDisabled();
+		if (renderSettings.useRenderQueue) ImGui::TextDisabled("The render queue orders the scene instead");
+		const char* prepassModes[] = { "Without pre-pass", "With pre-pass" };
+		for (int i = 0; i < 2; i++) {
+			if (renderStats.pipelineStatistics)
+				ImGui::Text("%-17s %llu fragments shaded, %.3f ms GPU%s", prepassModes[i], renderStats.sceneFragments[i], renderStats.sceneGpuMs[i], renderStats.depthPrepass == (i == 1) ? " (current)" : "");
+			else
+				ImGui::Text("%-17s %.3f ms GPU%s", prepassModes[i], renderStats.sceneGpuMs[i], renderStats.depthPrepass == (i == 1) ? " (current)" : "");
+		}
+		if (renderStats.pipelineStatistics && renderStats.sceneFragments[0] > 0 && renderStats.sceneFragments[1] > 0) {
+			long long saved = (long long)renderStats.sceneFragments[0] - (long long)renderStats.sceneFragments[1];
+			ImGui::Text("Fragment invocations saved: %lld (%.1f%%)", saved, 100.0 * saved / renderStats.sceneFragments[0]);
+		}
+		if (!renderStats.pipelineStatistics) ImGui::TextDisabled("Pipeline statistics queries unsupported");
+
+		ImGui::SeparatorText("Point lights");
+
+		ImGui::Checkbox("Clustered lights", &renderSettings.clusteredLights);
+		ImGui::Checkbox("Show light density", &renderSettings.showLightDensity);
+		ImGui::Text("%zu lights, %u uploads, %d x %d x %d clusters", renderStats.pointLights, renderStats.lightUploads, LightClusters::tilesX, LightClusters::tilesY, LightClusters::slices);
+		ImGui::Text("%d clusters lit, %zu references, at most %d per cluster", renderStats.lightClustersOccupied, renderStats.lightIndices, renderStats.maxLightsPerCluster);
+		ImGui::Text("Assignment: %.3f ms CPU", renderStats.lightAssignMs);
+
+		ImGui::SeparatorText("Submission");
+
+		ImGui::Checkbox("Command buffers", &renderSettings.useCommandBuffers);
+		ImGui::Text("Recording threads: %u", renderStats.recordThreads);
+
+		bool runSubmissionBenchmark = ImGui::Button("Benchmark submission");
+
+		if (renderStats.hasSubmissionBenchmark && ImGui::BeginTable("Submission Benchmark", 4)) {
+			ImGui::TableSetupColumn("Meshes");
+			ImGui::TableSetupColumn("Direct (ms)");
+			ImGui::TableSetupColumn("Record (ms)");
+			ImGui::TableSetupColumn("Replay (ms)");
+			ImGui::TableHeadersRow();
+
+			for (const SubmissionTiming& timing : renderStats.submissionBenchmark) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%u", timing.meshCount);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", timing.directMs);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", timing.recordMs);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", timing.replayMs);
+			}
+
+			ImGui::EndTable();
+		}
+
+		ImGui::End();
+
+		ImGui::Begin("Height Query");
+
+		ImGui::Checkbox("From GPU readback", &renderSettings.readbackHeightMap);
+		if (renderSettings.readbackHeightMap)
+			ImGui::Text("Snapshot of frame %u (%u frames old)", queriedFrame, queriedFrame == 0 ? 0 : frameIndex - queriedFrame);
+
+		if (!heightQuery.isEmpty()) {
+			SurfaceSample below = heightQuery.sample(camera.Position.x, camera.Position.z);
+			ImGui::Text("Below camera: %.3f (normal %.2f, %.2f, %.2f)%s", below.position.y, below.normal.x, below.normal.y, below.normal.z,
+				heightQuery.contains(camera.Position.x, camera.Position.z) ? "" : " outside");
+
+			SurfaceSample hit;
+			if (heightQuery.raycast(camera.Position, camera.front, 200.0f, hit))
+				ImGui::Text("Looking at: %.2f, %.2f, %.2f (%.2f away)", hit.position.x, hit.position.y, hit.position.z, glm::length(hit.position - camera.Position));
+			else
+				ImGui::Text("Looking at: nothing");
+
+			if (ImGui::Button("Benchmark 100k points")) {
+				const size_t count = 100000;
+				queryX.resize(count);
+				queryZ.resize(count);
+				queryResults.resize(count);
+
+				for (size_t i = 0; i < count; i++) {
+					queryX[i] = HonmoonCenter.x + HonmoonSize.x * areaScale * ((i * 7919 % count) / float(count) - 0.5f);
+					queryZ[i] = HonmoonCenter.z + HonmoonSize.z * areaScale * ((i * 104729 % count) / float(count) - 0.5f);
+				}
+
+				auto start = std::chrono::high_resolution_clock::now();
+				for (size_t i = 0; i < count; i++) queryResults[i] = heightQuery.sample(queryX[i], queryZ[i]);
+				auto middle = std::chrono::high_resolution_clock::now();
+				heightQuery.sample(queryX.data(), queryZ.data(), count, queryResults.data());
+				auto end = std::chrono::high_resolution_clock::now();
+
+				batchScalarMs = std::chrono::duration<float, std::milli>(middle - start).count();
+				batchMs = std::chrono::duration<float, std::milli>(end - middle).count();
+			}
+
+			ImGui::Text("Batched (%s): %.3f ms, one by one: %.3f ms", HeightQuery::HasAVX2() ? "AVX2" : "scalar", batchMs, batchScalarMs);
+			if (!renderSettings.readbackHeightMap)
+				ImGui::Text("CPU bake: %.2f ms", queryBake.getTiming().transformMs + queryBake.getTiming().binMs + queryBake.getTiming().rasterMs);
+		}
+
+		ImGui::End();
+
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 #pragma endregion
 
-		glfwSwapBuffers(window);
+#pragma region Frame Packet
+		FramePacket* packet = frameQueue.beginWrite();
+		if (packet == nullptr) break;
+
+		packet->frameIndex = ++frameIndex;
+		packet->time = myTime;
+		packet->dt = dt;
+		packet->width = SCR_WIDTH;
+		packet->height = SCR_HEIGHT;
+
+		packet->camera.viewMatrix = camera.viewMatrix;
+		packet->camera.projectionMatrix = camera.projectionMatrix;
+		packet->camera.Position = camera.Position;
+
+		packet->light.direction = lightDir;
+		packet->light.ambient = ambient;
+		packet->light.diffuse = diffuse;
+		packet->light.specular = specular;
+
+		packet->honmoon.size = HonmoonSize * areaScale;
+		packet->honmoon.position = HonmoonCenter - packet->honmoon.size / 2.0f;
+		packet->honmoon.center = HonmoonCenter;
+		packet->honmoon.patternOrigin = Honmoon_GlobalOrigin;
+		packet->honmoon.hoverHeight = hoverHeight;
+		packet->honmoon.thickness = thickness;
+		packet->honmoon.spacing = spacing;
+		packet->honmoon.progress = progress;
+		packet->honmoon.heightMapResolution = heightMapResolution;
+		packet->honmoon.gridResolution = gridResolution;
+		packet->honmoon.patchSize = patchSize;
+		packet->honmoon.lodDistance = lodDistance;
+		packet->honmoon.barrierGridResolution = barrierGridResolution;
+		packet->honmoon.rippleSpeed = rippleSpeed;
+		packet->honmoon.rippleWavelength = rippleWavelength;
+		packet->honmoon.rippleLifetime = rippleLifetime;
+		packet->honmoon.rippleAmplitude = rippleAmplitude;
+		packet->honmoon.clipmapTexelSize = clipmapTexelSize;
+		packet->honmoon.clipmapTileBudget = clipmapTileBudget;
+		packet->honmoon.color1 = glm::vec4(35, 218, 215, 255) / 255.0f; // primary color
+		packet->honmoon.color2 = glm::vec4(4, 90, 107, 10) / 255.0f; // secondary color
+
+		BuildDrawList(models, indexes, modelProperties, packet->drawList);
+		// The render queue sorts by state ahead of depth on the render thread, which would throw this order away
+		if (renderSettings.sortFrontToBack && !renderSettings.useRenderQueue) SortFrontToBack(packet->drawList, camera.Position);
+
+		if (barrierCount != scatteredCount || barrierSize != scatteredSize || barrierArea != packet->honmoon.size) {
+			barriers = barrierCount > 0 ? ScatterBarriers(packet->honmoon, barrierCount, barrierSize) : nullptr;
+			scatteredCount = barrierCount;
+			scatteredSize = barrierSize;
+			barrierArea = packet->honmoon.size;
+		}
+		packet->barriers = barriers;
+
+		glm::vec4 lanternLayout(lanternCount, lanternRadius, lanternHeight, lanternIntensity);
+		if (lanternLayout != scatteredLanterns || lanternArea != packet->honmoon.size) {
+			lanterns = lanternCount > 0 ? ScatterLanterns(packet->honmoon, lanternCount, lanternRadius, lanternHeight, lanternIntensity) : nullptr;
+			scatteredLanterns = lanternLayout;
+			lanternArea = packet->honmoon.size;
+		}
+		packet->pointLights = lanterns;
+
+		packet->dirtyBounds.swap(dirtyBounds);
+		dirtyBounds.clear();
+
+		rippleBacklog += ripplesPerSecond * dt;
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (; rippleBacklog >= 1.0f; rippleBacklog -= 1.0f) {
+			glm::vec2 origin = glm::vec2(packet->honmoon.position.x, packet->honmoon.position.z) + glm::vec2(unit(rippleRandom), unit(rippleRandom)) * glm::vec2(packet->honmoon.size.x, packet->honmoon.size.z);
+			ripples.push_back({ origin, myTime, 0.5f + 0.5f * unit(rippleRandom) });
+		}
+
+		packet->ripples.swap(ripples);
+		ripples.clear();
+
+		if (renderSettings.readbackHeightMap) {
+			// A few frames behind the scene, but costs the main thread nothing but the mip build
+			std::shared_ptr<const HeightMapSnapshot> snapshot = frameQueue.latestHeightMap();
+			if (snapshot && snapshot->frameIndex != queriedFrame) {
+				heightQuery.build(snapshot->depth, snapshot->width, snapshot->height, snapshot->honmoon);
+				queriedFrame = snapshot->frameIndex;
+			}
+			queriedSize = glm::vec3(0.0f);
+		}
+		else {
+			queryDirty = queryDirty || !packet->dirtyBounds.empty();
+
+			bool invalid = heightQuery.isEmpty() || queriedFrame != 0 || queryBake.getWidth() != heightMapResolution || queriedSize != packet->honmoon.size;
+			bool settled = packet->dirtyBounds.empty();
+			if (invalid || (queryDirty && (settled || myTime - queryBakedTime >= queryRebakeInterval))) {
+				queryBake.resize(heightMapResolution, heightMapResolution);
+				queryBake.bake(models, packet->drawList, packet->honmoon, queryWorkers);
+				heightQuery.build(queryBake.getDepth(), queryBake.getWidth(), queryBake.getHeight(), packet->honmoon);
+				queriedSize = packet->honmoon.size;
+				queriedFrame = 0;
+				queryDirty = false;
+				queryBakedTime = myTime;
+			}
+		}
+
+		// Same displacement as the uniform grid this frame
+		heightQuery.setHoverHeight(hoverHeight);
+		heightQuery.setLod(std::max(std::log2(heightMapResolution / (float)gridResolution), 0.0f));
+		packet->settings = renderSettings;
+		packet->settings.runSubmissionBenchmark = runSubmissionBenchmark;
+		packet->settings.runGridBenchmark = runGridBenchmark;
+		packet->settings.runCpuBakeBenchmark = runCpuBakeBenchmark;
+
+		packet->gui.copy(ImGui::GetDrawData());
+
+		frameQueue.endWrite();
 #pragma endregion
 	}
 #pragma endregion
 
+#pragma region Stop Render Thread
+	frameQueue.close();
+	renderThread.join();
+
+	glfwMakeContextCurrent(window);
+#pragma endregion
+
 #pragma region Terminate
 
 	ImGui_ImplOpenGL3_Shutdown();